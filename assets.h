@@ -0,0 +1,101 @@
+#include "definitions.h"
+#include "bmpio.h"
+#include "texture.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#ifndef ASSETS_H
+#define ASSETS_H
+
+/******************************************************
+ * ASSET_CACHE:
+ * Loads each image file once and hands out shared,
+ * read-only handles to it, so scenes can ask for their
+ * images every frame for the price of a lookup. The
+ * cache keeps every asset alive until 'clear', which
+ * also makes them safe to reference from triangles
+ * still queued in the tile renderer.
+ *
+ * Textures are cached per path and sampler mode; the
+ * pyramid of a file used with two different modes is
+ * built twice.
+ *****************************************************/
+class AssetCache
+{
+    private:
+        std::mutex lock;
+        std::unordered_map<std::string, std::shared_ptr<const Buffer2D<PIXEL> > > images;
+        std::unordered_map<std::string, std::shared_ptr<const Texture> > textures;
+
+        // Native decoder first, SDL for anything it does not handle
+        static std::shared_ptr<const Buffer2D<PIXEL> > loadImage(const char* path)
+        {
+            Buffer2D<PIXEL>* image = LoadBMP(path);
+            if(image == NULL)
+            {
+                BufferImage surface(path);
+                if(surface.width() == 0)
+                {
+                    return std::shared_ptr<const Buffer2D<PIXEL> >();
+                }
+                image = new Buffer2D<PIXEL>(surface);
+            }
+            return std::shared_ptr<const Buffer2D<PIXEL> >(image);
+        }
+
+    public:
+        // Image at 'path', NULL if it could not be loaded
+        std::shared_ptr<const Buffer2D<PIXEL> > image(const char* path)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            std::shared_ptr<const Buffer2D<PIXEL> > & slot = images[path];
+            if(!slot)
+            {
+                slot = loadImage(path);
+            }
+            return slot;
+        }
+
+        // Mipmapped texture of the image at 'path', NULL if it could not be loaded
+        std::shared_ptr<const Texture> texture(const char* path, TEXTURE_WRAP wrap = WRAP_REPEAT, TEXTURE_FILTER filter = FILTER_BILINEAR)
+        {
+            std::shared_ptr<const Buffer2D<PIXEL> > source = image(path);
+            if(!source)
+            {
+                return std::shared_ptr<const Texture>();
+            }
+
+            std::string key = std::string(path) + (wrap == WRAP_CLAMP ? "|clamp" : "|repeat") +
+                              (filter == FILTER_NEAREST ? "|nearest" : "|bilinear");
+            std::lock_guard<std::mutex> guard(lock);
+            std::shared_ptr<const Texture> & slot = textures[key];
+            if(!slot)
+            {
+                std::shared_ptr<Texture> tex = std::make_shared<Texture>(*source);
+                tex->setWrap(wrap);
+                tex->setFilter(filter);
+                slot = tex;
+            }
+            return slot;
+        }
+
+        // Drop the cache's references once queued triangles are done
+        // with them, outstanding handles stay valid
+        void clear()
+        {
+            FlushPipeline();
+            std::lock_guard<std::mutex> guard(lock);
+            images.clear();
+            textures.clear();
+        }
+};
+
+inline AssetCache & GetAssetCache()
+{
+    static AssetCache cache;
+    return cache;
+}
+
+#endif
@@ -0,0 +1,295 @@
+#include "definitions.h"
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef BMP_IO_H
+#define BMP_IO_H
+
+/******************************************************
+ * SAVE_BMP:
+ * Writes 'image' as an uncompressed 32-bit BMP, or as
+ * 24-bit with alpha dropped when 'bitsPerPixel' is 24.
+ * Row 0 of the buffer is the bottom of the picture,
+ * which is also the order BMP stores rows in. Returns
+ * false if the file could not be written.
+ *****************************************************/
+inline bool SaveBMP(const Buffer2D<PIXEL> & image, const char* path, const int & bitsPerPixel = 32)
+{
+    FILE* file = fopen(path, "wb");
+    if(file == NULL)
+    {
+        return false;
+    }
+
+    int w = image.width();
+    int h = image.height();
+    int bytes = bitsPerPixel == 24 ? 3 : 4;
+    uint32_t stride = (uint32_t)((w * bytes + 3) & ~3);
+    uint32_t pixelBytes = stride * (uint32_t)h;
+    unsigned char header[54] = {0};
+    uint32_t fields[] = { 54 + pixelBytes, 0, 54, 40, (uint32_t)w, (uint32_t)h };
+
+    header[0] = 'B';
+    header[1] = 'M';
+    memcpy(header + 2, fields, sizeof(fields));
+    header[26] = 1;                             // Planes
+    header[28] = (unsigned char)(bytes * 8);    // Bits per pixel
+    memcpy(header + 34, &pixelBytes, 4);
+
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    if(bytes == 4)
+    {
+        for(int y = 0; y < h && ok; y++)
+        {
+            ok = fwrite(image[y], sizeof(PIXEL), w, file) == (size_t)w;
+        }
+    }
+    else
+    {
+        std::vector<unsigned char> row(stride, 0);
+        for(int y = 0; y < h && ok; y++)
+        {
+            for(int x = 0; x < w; x++)
+            {
+                PIXEL p = image[y][x];
+                row[x * 3 + 0] = (unsigned char)(p & 0xff);
+                row[x * 3 + 1] = (unsigned char)((p >> 8) & 0xff);
+                row[x * 3 + 2] = (unsigned char)((p >> 16) & 0xff);
+            }
+            ok = fwrite(&row[0], 1, stride, file) == stride;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+/******************************************************
+ * MAPPED_FILE:
+ * Read-only view of a whole file, memory-mapped where
+ * the platform allows and read into memory otherwise.
+ * 'data' is NULL if the file could not be opened.
+ *****************************************************/
+class MappedFile
+{
+    private:
+#ifdef _WIN32
+        std::vector<unsigned char> contents;
+#endif
+
+    public:
+        const unsigned char* data;
+        size_t size;
+
+        explicit MappedFile(const char* path) : data(NULL), size(0)
+        {
+#ifdef _WIN32
+            FILE* file = fopen(path, "rb");
+            if(file == NULL)
+            {
+                return;
+            }
+            fseek(file, 0, SEEK_END);
+            long length = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            if(length > 0)
+            {
+                contents.resize((size_t)length);
+                if(fread(&contents[0], 1, contents.size(), file) == contents.size())
+                {
+                    data = &contents[0];
+                    size = contents.size();
+                }
+            }
+            fclose(file);
+#else
+            int fd = open(path, O_RDONLY);
+            if(fd < 0)
+            {
+                return;
+            }
+            struct stat info;
+            if(fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                void* mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(mapped != MAP_FAILED)
+                {
+                    data = (const unsigned char*)mapped;
+                    size = (size_t)info.st_size;
+                }
+            }
+            close(fd);
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifndef _WIN32
+            if(data != NULL)
+            {
+                munmap((void*)data, size);
+            }
+#endif
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile & operator=(const MappedFile &) = delete;
+};
+
+// Little-endian field readers for the BMP headers
+inline uint32_t BmpRead32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint16_t BmpRead16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/******************************************************
+ * LOAD_BMP:
+ * Decodes an uncompressed BMP straight into a new
+ * buffer as ARGB8888 with row 0 at the bottom, the layout
+ * BufferImage presents, without an SDL surface in
+ * between. Handles 8-bit paletted, 24-bit and 32-bit
+ * (plain or bitfields) files, bottom-up or top-down.
+ * Opacity follows SDL_LoadBMP: 32-bit files whose
+ * alpha is zero everywhere are made opaque. Returns 
+ * NULL for anything else; the caller owns the buffer.
+ *****************************************************/
+inline Buffer2D<PIXEL>* LoadBMP(const char* path)
+{
+    MappedFile file(path);
+    const unsigned char* d = file.data;
+    if(d == NULL || file.size < 54 || d[0] != 'B' || d[1] != 'M')
+    {
+        return NULL;
+    }
+
+    uint32_t pixelOffset = BmpRead32(d + 10);
+    uint32_t headerSize = BmpRead32(d + 14);
+    int32_t w = (int32_t)BmpRead32(d + 18);
+    int32_t h = (int32_t)BmpRead32(d + 22);
+    int bpp = BmpRead16(d + 28);
+    uint32_t compression = BmpRead32(d + 30);
+    bool topDown = h < 0;
+    h = topDown ? -h : h;
+    if(w <= 0 || h <= 0 || headerSize < 40)
+    {
+        return NULL;
+    }
+
+    // Channel masks, BI_BITFIELDS stores them after the 40 byte header
+    uint32_t masks[4] = { 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 };
+    if(compression == 3 && bpp == 32)
+    {
+        if(14 + 40 + 12 > file.size)
+        {
+            return NULL;
+        }
+        for(int m = 0; m < 3; m++)
+        {
+            masks[m] = BmpRead32(d + 54 + 4 * m);
+        }
+        masks[3] = headerSize >= 56 ? BmpRead32(d + 54 + 12) : 0;
+    }
+    else if(compression != 0 || (bpp != 8 && bpp != 24 && bpp != 32))
+    {
+        return NULL;
+    }
+
+    size_t stride = (((size_t)w * bpp + 31) / 32) * 4;
+    if(pixelOffset > file.size || stride * h > file.size - pixelOffset)
+    {
+        return NULL;
+    }
+
+    const unsigned char* palette = d + 14 + headerSize;
+    uint32_t paletteSize = BmpRead32(d + 46);
+    paletteSize = paletteSize == 0 ? 256 : paletteSize;
+    if(bpp == 8 && palette + paletteSize * 4 > d + pixelOffset)
+    {
+        return NULL;
+    }
+
+    bool plainMasks = masks[0] == 0x00ff0000 && masks[1] == 0x0000ff00 && masks[2] == 0x000000ff;
+    int shifts[4];
+    for(int m = 0; m < 4; m++)
+    {
+        shifts[m] = 0;
+        while(masks[m] != 0 && ((masks[m] >> shifts[m]) & 1) == 0)
+        {
+            shifts[m]++;
+        }
+    }
+
+    Buffer2D<PIXEL>* image = new Buffer2D<PIXEL>(w, h);
+    Buffer2D<PIXEL> & out = *image;
+    PIXEL alphaSeen = 0;
+    for(int y = 0; y < h; y++)
+    {
+        const unsigned char* src = d + pixelOffset + stride * (topDown ? h - 1 - y : y);
+        PIXEL* dst = out[y];
+        if(bpp == 32 && plainMasks)
+        {
+            memcpy(dst, src, sizeof(PIXEL) * w);
+            for(int x = 0; x < w; x++)
+            {
+                alphaSeen |= dst[x];
+            }
+        }
+        else if(bpp == 32)
+        {
+            for(int x = 0; x < w; x++)
+            {
+                uint32_t raw = BmpRead32(src + 4 * x);
+                PIXEL a = masks[3] != 0 ? ((raw & masks[3]) >> shifts[3]) & 0xff : 0;
+                alphaSeen |= a << 24;
+                dst[x] = (a << 24) | ((((raw & masks[0]) >> shifts[0]) & 0xff) << 16) |
+                         ((((raw & masks[1]) >> shifts[1]) & 0xff) << 8) | (((raw & masks[2]) >> shifts[2]) & 0xff);
+            }
+        }
+        else if(bpp == 24)
+        {
+            // Four byte loads for all but the last pixel of the row
+            for(int x = 0; x < w - 1; x++)
+            {
+                uint32_t raw;
+                memcpy(&raw, src + 3 * x, sizeof(raw));
+                dst[x] = 0xff000000 | (raw & 0x00ffffff);
+            }
+            const unsigned char* last = src + 3 * (w - 1);
+            dst[w - 1] = 0xff000000 | ((PIXEL)last[2] << 16) | ((PIXEL)last[1] << 8) | last[0];
+        }
+        else
+        {
+            for(int x = 0; x < w; x++)
+            {
+                const unsigned char* entry = palette + 4 * (src[x] < paletteSize ? src[x] : 0);
+                dst[x] = 0xff000000 | ((PIXEL)entry[2] << 16) | ((PIXEL)entry[1] << 8) | entry[0];
+            }
+        }
+    }
+
+    // All-zero alpha means the file never used it, as SDL_LoadBMP decides
+    if(bpp == 32 && (alphaSeen & 0xff000000) == 0)
+    {
+        for(int y = 0; y < h; y++)
+        {
+            PIXEL* row = out[y];
+            for(int x = 0; x < w; x++)
+            {
+                row[x] |= 0xff000000;
+            }
+        }
+    }
+
+    return image;
+}
+
+#endif
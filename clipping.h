@@ -0,0 +1,303 @@
+#include "definitions.h"
+#include "halfspace.h"
+
+#ifndef CLIPPING_H
+#define CLIPPING_H
+
+// Smallest w kept after clipping, keeps 1/w finite
+#define CLIP_W_EPSILON 1e-5
+
+/******************************************************
+ * Planes of the homogeneous clip volume. Near and
+ * W_ZERO are always clipped against. The side planes
+ * sit at the guard band (x, y = +-guardBand * w), so
+ * only geometry reaching past it is ever split; the
+ * rest is left for the rasterizer's scissor.
+ *****************************************************/
+enum CLIP_PLANES
+{
+    CLIP_NEAR   = 1 << 0,
+    CLIP_W_ZERO = 1 << 1,
+    CLIP_LEFT   = 1 << 2,
+    CLIP_RIGHT  = 1 << 3,
+    CLIP_BOTTOM = 1 << 4,
+    CLIP_TOP    = 1 << 5,
+    NUM_CLIP_PLANES = 6
+};
+
+/******************************************************
+ * CLIP_STATE:
+ * Pipeline state for the clipping stage. When disabled
+ * the vertex shader is expected to output screen-space
+ * vertices (as the earlier test scenes do) and
+ * clipping, normalization and the viewport transform
+ * are all skipped. 'guardBand' is in NDC units, 1.0
+ * clips exactly at the viewport edges.
+ *****************************************************/
+struct ClipState
+{
+    bool enabled;
+    double guardBand;
+
+    ClipState() : enabled(false), guardBand(2.0)
+    {
+    }
+};
+
+inline ClipState & GetClipState()
+{
+    static ClipState state;
+    return state;
+}
+
+/******************************************************
+ * Signed distance of 'v' to one plane, inside >= 0.
+ *****************************************************/
+inline double ClipDistance(const Vertex & v, const int & plane, const double & guard)
+{
+    switch(plane)
+    {
+        case CLIP_NEAR:
+            return v.z + v.w;
+        case CLIP_W_ZERO:
+            return v.w - CLIP_W_EPSILON;
+        case CLIP_LEFT:
+            return guard * v.w + v.x;
+        case CLIP_RIGHT:
+            return guard * v.w - v.x;
+        case CLIP_BOTTOM:
+            return guard * v.w + v.y;
+        case CLIP_TOP:
+            return guard * v.w - v.y;
+    }
+    return 0;
+}
+
+/******************************************************
+ * Bit set of the planes 'v' lies outside of.
+ *****************************************************/
+inline int ClipOutcode(const Vertex & v, const double & guard)
+{
+    int code = 0;
+    for(int p = 0; p < NUM_CLIP_PLANES; p++)
+    {
+        if(ClipDistance(v, 1 << p, guard) < 0)
+        {
+            code |= 1 << p;
+        }
+    }
+    return code;
+}
+
+/******************************************************
+ * Vertex 't' of the way from 'a' to 'b'.
+ *****************************************************/
+inline Vertex LerpVertex(const Vertex & a, const Vertex & b, const double & t)
+{
+    Vertex out = { a.x + (b.x - a.x) * t,
+                   a.y + (b.y - a.y) * t,
+                   a.z + (b.z - a.z) * t,
+                   a.w + (b.w - a.w) * t };
+    return out;
+}
+
+/******************************************************
+ * Sutherland-Hodgman clip of a convex polygon against
+ * the planes in 'planes', in place. Attributes are
+ * still in clip space here so linear interpolation is
+ * correct. Returns the new vertex count, 0 when
+ * nothing is left. 'verts' and 'attrs' must hold
+ * MAX_VERTICES entries.
+ *****************************************************/
+inline int ClipPolygon(Vertex verts[], Attributes attrs[], int num, const int & planes, const double & guard)
+{
+    Vertex tmpVerts[MAX_VERTICES];
+    Attributes tmpAttrs[MAX_VERTICES];
+
+    for(int p = 0; p < NUM_CLIP_PLANES && num > 0; p++)
+    {
+        int plane = 1 << p;
+        if((planes & plane) == 0)
+        {
+            continue;
+        }
+
+        int out = 0;
+        for(int i = 0; i < num; i++)
+        {
+            int j = (i + 1) % num;
+            double di = ClipDistance(verts[i], plane, guard);
+            double dj = ClipDistance(verts[j], plane, guard);
+
+            if(di >= 0)
+            {
+                tmpVerts[out] = verts[i];
+                tmpAttrs[out] = attrs[i];
+                out++;
+            }
+            if((di >= 0) != (dj >= 0))
+            {
+                double t = di / (di - dj);
+                tmpVerts[out] = LerpVertex(verts[i], verts[j], t);
+                tmpAttrs[out] = Attributes(attrs[i], attrs[j], t);
+                out++;
+            }
+        }
+
+        for(int i = 0; i < out; i++)
+        {
+            verts[i] = tmpVerts[i];
+            attrs[i] = tmpAttrs[i];
+        }
+        num = out;
+    }
+    return num;
+}
+
+/******************************************************
+ * Parametric clip of the segment verts[0]-verts[1], in
+ * place. Returns false when the whole line is outside.
+ *****************************************************/
+inline bool ClipSegment(Vertex verts[], Attributes attrs[], const int & planes, const double & guard)
+{
+    double t0 = 0;
+    double t1 = 1;
+    for(int p = 0; p < NUM_CLIP_PLANES; p++)
+    {
+        int plane = 1 << p;
+        if((planes & plane) == 0)
+        {
+            continue;
+        }
+
+        double d0 = ClipDistance(verts[0], plane, guard);
+        double d1 = ClipDistance(verts[1], plane, guard);
+        if(d0 < 0 && d1 < 0)
+        {
+            return false;
+        }
+        if(d0 < 0)
+        {
+            t0 = MAX(t0, d0 / (d0 - d1));
+        }
+        else if(d1 < 0)
+        {
+            t1 = MIN(t1, d0 / (d0 - d1));
+        }
+    }
+    if(t0 > t1)
+    {
+        return false;
+    }
+
+    Vertex a = LerpVertex(verts[0], verts[1], t0);
+    Vertex b = LerpVertex(verts[0], verts[1], t1);
+    Attributes aAttr(attrs[0], attrs[1], t0);
+    Attributes bAttr(attrs[0], attrs[1], t1);
+    verts[0] = a;
+    verts[1] = b;
+    attrs[0] = aAttr;
+    attrs[1] = bAttr;
+    return true;
+}
+
+/******************************************************
+ * Perspective divide. Afterwards w holds 1/w and the
+ * attribute slots are pre-multiplied by it, which is
+ * what the rasterizer interpolates.
+ *****************************************************/
+inline void NormalizeVertices(Vertex verts[], Attributes attrs[], const int & num)
+{
+    for(int i = 0; i < num; i++)
+    {
+        double invW = 1.0 / verts[i].w;
+        verts[i].x *= invW;
+        verts[i].y *= invW;
+        verts[i].z *= invW;
+        verts[i].w = invW;
+
+        float scale = (float)invW;
+        for(int s = 0; s < MAX_ATTRIBUTES; s++)
+        {
+            attrs[i].value[s] *= scale;
+        }
+    }
+}
+
+/******************************************************
+ * Maps NDC [-1, 1] onto the 'width' x 'height' 
+ * viewport at ('x', 'y') of the target. Frames are 
+ * stored bottom-up so +y stays up.
+ *****************************************************/
+inline void ViewportTransform(Vertex verts[], const int & num, const int & x, const int & y, const int & width, const int & height)
+{
+    for(int i = 0; i < num; i++)
+    {
+        verts[i].x = x + (verts[i].x + 1.0) * 0.5 * width;
+        verts[i].y = y + (verts[i].y + 1.0) * 0.5 * height;
+    }
+}
+
+/******************************************************
+ * Sutherland-Hodgman clip of a screen-space polygon 
+ * to the rasterizer's snapping range, in place, for 
+ * geometry that never went through the clip volume.
+ * Position, 1/w and the pre-multiplied attribute 
+ * slots are all linear in screen space, so the new
+ * vertices are exact. Polygons already in range are
+ * left untouched. Returns the new vertex count; 
+ * 'verts' and 'attrs' must hold MAX_VERTICES entries.
+ *****************************************************/
+inline int ClipToSnapRange(Vertex verts[], Attributes attrs[], int num)
+{
+    bool inside = true;
+    for(int i = 0; i < num; i++)
+    {
+        inside = inside && InSnapRange(verts[i]);
+    }
+    if(inside)
+    {
+        return num;
+    }
+
+    const double limit = RASTER_COORD_LIMIT - 1;
+    Vertex tmpVerts[MAX_VERTICES];
+    Attributes tmpAttrs[MAX_VERTICES];
+
+    // Planes x >= -limit, x <= limit, y >= -limit, y <= limit
+    for(int p = 0; p < 4 && num > 0; p++)
+    {
+        double sign = (p & 1) ? -1.0 : 1.0;
+        int out = 0;
+        for(int i = 0; i < num; i++)
+        {
+            int j = (i + 1) % num;
+            double di = limit + sign * (p < 2 ? verts[i].x : verts[i].y);
+            double dj = limit + sign * (p < 2 ? verts[j].x : verts[j].y);
+
+            if(di >= 0)
+            {
+                tmpVerts[out] = verts[i];
+                tmpAttrs[out] = attrs[i];
+                out++;
+            }
+            if((di >= 0) != (dj >= 0))
+            {
+                double t = di / (di - dj);
+                tmpVerts[out] = LerpVertex(verts[i], verts[j], t);
+                tmpAttrs[out] = Attributes(attrs[i], attrs[j], t);
+                out++;
+            }
+        }
+
+        for(int i = 0; i < out; i++)
+        {
+            verts[i] = tmpVerts[i];
+            attrs[i] = tmpAttrs[i];
+        }
+        num = out;
+    }
+    return num;
+}
+
+#endif
@@ -0,0 +1,360 @@
+#include "definitions.h"
+#include "viewport.h"
+#include "clipping.h"
+#include "cull.h"
+#include <algorithm>
+#include <vector>
+
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+/******************************************************
+ * COMMAND_STATE:
+ * Everything a recorded draw depends on besides its
+ * geometry. Uniforms are held by value; the texture
+ * (or any other uniform pointer) is 'uniforms.ptrImg'.
+ * A NULL 'zBuf' draws without depth testing.
+ *****************************************************/
+struct CommandState
+{
+    FragmentShader* frag;
+    VertexShader* vert;
+    Attributes uniforms;
+    DepthBuffer* zBuf;
+    ViewportState view;
+    CullState cull;
+    ClipState clip;
+
+    bool operator==(const CommandState & rhs) const
+    {
+        return frag == rhs.frag && vert == rhs.vert && zBuf == rhs.zBuf &&
+               uniforms.ptrImg == rhs.uniforms.ptrImg && uniforms.numMembers == rhs.uniforms.numMembers &&
+               memcmp(uniforms.value, rhs.uniforms.value, sizeof(uniforms.value)) == 0 &&
+               memcmp(&view.viewport, &rhs.view.viewport, sizeof(ScreenRect)) == 0 &&
+               memcmp(&view.scissor, &rhs.view.scissor, sizeof(ScreenRect)) == 0 &&
+               view.scissorTest == rhs.view.scissorTest &&
+               cull.mode == rhs.cull.mode && cull.frontFace == rhs.cull.frontFace &&
+               clip.enabled == rhs.clip.enabled && clip.guardBand == rhs.clip.guardBand;
+    }
+};
+
+/******************************************************
+ * COMMAND_BUFFER:
+ * Records draws and state changes once and replays
+ * them as often as needed. Recording copies the
+ * geometry, so the source arrays can go away; state
+ * starts from the pipeline state current at 'reset'
+ * (or construction) and changes like the immediate
+ * API. Shader, depth buffer and texture objects are
+ * referenced and must outlive the buffer.
+ *
+ * On the first submit after recording, the buffer is
+ * compiled into batches: consecutive draws of one
+ * primitive type under equal state merge into a single
+ * indexed draw over one vertex range, a restart index
+ * between each, so replay costs one call (and one 
+ * vertex-stage batch) per batch and draws exactly what
+ * the separate DrawElements calls would.
+ * With state sorting on, draws are first grouped by
+ * vertex shader, fragment shader, texture and depth
+ * buffer, each ranked by its first use in recording
+ * order (never by address, so replays are the same
+ * from run to run). This changes the draw order; 
+ * only use it for depth-tested or otherwise 
+ * order-independent content.
+ *
+ * Submitting applies each batch's state and restores
+ * the caller's pipeline state afterwards.
+ *****************************************************/
+class CommandBuffer
+{
+    private:
+        // One recorded draw: 'count' indices into its own vertices
+        struct DrawCommand
+        {
+            PRIMITIVES prim;
+            int state;
+            int firstVertex;
+            int numVertices;
+            int firstIndex;
+            int count;
+        };
+
+        // One replayed draw over the compiled arrays
+        struct Batch
+        {
+            PRIMITIVES prim;
+            int state;
+            int firstIndex;
+            int count;
+        };
+
+        std::vector<CommandState> states;
+        std::vector<DrawCommand> draws;
+        std::vector<Vertex> verts;
+        std::vector<Attributes> attrs;
+        std::vector<unsigned int> indices;
+        CommandState current;
+        int currentIdx;             // Entry of 'current' in 'states', -1 if not yet stored
+
+        // Keys states are sorted on: vertex shader, fragment shader, texture, depth buffer
+        enum { SORT_KEYS = 4 };
+
+        bool sortByState;
+        bool compiled;
+        std::vector<int> keyRanks;  // SORT_KEYS first-use ranks per state
+        std::vector<Batch> batches;
+        std::vector<Vertex> batchVerts;
+        std::vector<Attributes> batchAttrs;
+        std::vector<unsigned int> batchIndices;
+
+        // Index of the current state, shared with any equal recorded one
+        int stateIndex()
+        {
+            if(currentIdx < 0)
+            {
+                for(size_t i = 0; i < states.size() && currentIdx < 0; i++)
+                {
+                    if(states[i] == current)
+                    {
+                        currentIdx = (int)i;
+                    }
+                }
+                if(currentIdx < 0)
+                {
+                    currentIdx = (int)states.size();
+                    states.push_back(current);
+                }
+            }
+            return currentIdx;
+        }
+
+        // Rank every state's sort keys by the order each distinct key is
+        // first drawn with
+        void rankStates()
+        {
+            keyRanks.assign(states.size() * SORT_KEYS, -1);
+            std::vector<const void*> seen[SORT_KEYS];
+            for(size_t i = 0; i < draws.size(); i++)
+            {
+                int s = draws[i].state;
+                if(keyRanks[s * SORT_KEYS] >= 0)
+                {
+                    continue;
+                }
+                const void* keys[SORT_KEYS] = {states[s].vert, states[s].frag, states[s].uniforms.ptrImg, states[s].zBuf};
+                for(int k = 0; k < SORT_KEYS; k++)
+                {
+                    size_t rank = std::find(seen[k].begin(), seen[k].end(), keys[k]) - seen[k].begin();
+                    if(rank == seen[k].size())
+                    {
+                        seen[k].push_back(keys[k]);
+                    }
+                    keyRanks[s * SORT_KEYS + k] = (int)rank;
+                }
+            }
+        }
+
+        // Order of state 'a' before 'b' when sorting
+        bool stateBefore(const int & a, const int & b) const
+        {
+            for(int k = 0; k < SORT_KEYS; k++)
+            {
+                int ra = keyRanks[a * SORT_KEYS + k];
+                int rb = keyRanks[b * SORT_KEYS + k];
+                if(ra != rb)
+                {
+                    return ra < rb;
+                }
+            }
+            return a < b;
+        }
+
+        // Build the batches and their vertex and index arrays
+        void compile()
+        {
+            std::vector<int> order(draws.size());
+            for(size_t i = 0; i < order.size(); i++)
+            {
+                order[i] = (int)i;
+            }
+            if(sortByState)
+            {
+                rankStates();
+                std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+                {
+                    return draws[a].state != draws[b].state && stateBefore(draws[a].state, draws[b].state);
+                });
+            }
+
+            batches.clear();
+            batchVerts.clear();
+            batchAttrs.clear();
+            batchIndices.clear();
+            for(size_t i = 0; i < order.size(); i++)
+            {
+                const DrawCommand & draw = draws[order[i]];
+                if(batches.empty() || batches.back().prim != draw.prim || batches.back().state != draw.state)
+                {
+                    Batch batch = {draw.prim, draw.state, (int)batchIndices.size(), 0};
+                    batches.push_back(batch);
+                }
+                else
+                {
+                    // A restart keeps a partial primitive left by the draw
+                    // before from joining this one's first indices
+                    batchIndices.push_back(PRIMITIVE_RESTART);
+                    batches.back().count++;
+                }
+
+                // Vertices of merged draws follow each other, indices other
+                // than restarts are rebased
+                unsigned int base = (unsigned int)batchVerts.size();
+                batchVerts.insert(batchVerts.end(), verts.begin() + draw.firstVertex, verts.begin() + draw.firstVertex + draw.numVertices);
+                batchAttrs.insert(batchAttrs.end(), attrs.begin() + draw.firstVertex, attrs.begin() + draw.firstVertex + draw.numVertices);
+                for(int k = 0; k < draw.count; k++)
+                {
+                    unsigned int idx = indices[draw.firstIndex + k];
+                    batchIndices.push_back(idx != PRIMITIVE_RESTART ? base + idx : idx);
+                }
+                batches.back().count += draw.count;
+            }
+            compiled = true;
+        }
+
+        // Copy a draw's geometry, 'idx' NULL meaning sequential. Index lists
+        // are kept whole, restarts decide which primitives they make.
+        void record(PRIMITIVES prim, const Vertex* v, const Attributes* a, const int & numVerts, const unsigned int* idx, int count)
+        {
+            if(idx == NULL)
+            {
+                count -= count % VerticesPerPrimitive(prim);
+            }
+            if(count <= 0 || numVerts <= 0)
+            {
+                return;
+            }
+            DrawCommand draw = {prim, stateIndex(), (int)verts.size(), numVerts, (int)indices.size(), count};
+            verts.insert(verts.end(), v, v + numVerts);
+            attrs.insert(attrs.end(), a, a + numVerts);
+            for(int k = 0; k < count; k++)
+            {
+                indices.push_back(idx != NULL ? idx[k] : (unsigned int)k);
+            }
+            draws.push_back(draw);
+            compiled = false;
+        }
+
+        // Mark the current state as changed
+        CommandState & change()
+        {
+            currentIdx = -1;
+            return current;
+        }
+
+    public:
+        CommandBuffer() : sortByState(false), compiled(false)
+        {
+            reset();
+        }
+
+        // Drop everything recorded, state restarts from the pipeline's
+        void reset()
+        {
+            states.clear();
+            draws.clear();
+            verts.clear();
+            attrs.clear();
+            indices.clear();
+            current.frag = NULL;
+            current.vert = NULL;
+            current.uniforms = Attributes();
+            current.zBuf = NULL;
+            current.view = GetViewportState();
+            current.cull = GetCullState();
+            current.clip = GetClipState();
+            currentIdx = -1;
+            compiled = false;
+        }
+
+        // State changes, affecting the draws recorded after them
+        void setFragmentShader(FragmentShader* frag)        { change().frag = frag; }
+        void setVertexShader(VertexShader* vert)            { change().vert = vert; }
+        void setUniforms(const Attributes & uniforms)       { change().uniforms = uniforms; }
+        void setTexture(const void* texture)                { change().uniforms.insertPtr(texture); }
+        void setDepthBuffer(DepthBuffer* zBuf)              { change().zBuf = zBuf; }
+        void setCullMode(CULL_MODES mode)                   { change().cull.mode = mode; }
+        void setClipping(bool enabled)                      { change().clip.enabled = enabled; }
+        void setScissorTest(bool enabled)                   { change().view.scissorTest = enabled; }
+
+        void setViewport(int x, int y, int width, int height)
+        {
+            ScreenRect rect = {x, y, x + (width > 0 ? width : 0), y + (height > 0 ? height : 0)};
+            change().view.viewport = rect;
+        }
+
+        void setScissor(int x, int y, int width, int height)
+        {
+            ScreenRect rect = {x, y, x + (width > 0 ? width : 0), y + (height > 0 ? height : 0)};
+            change().view.scissor = rect;
+        }
+
+        // Record 'count' vertices as a list of 'prim'
+        void draw(PRIMITIVES prim, const Vertex inputVerts[], const Attributes inputAttrs[], const int & count)
+        {
+            record(prim, inputVerts, inputAttrs, count, NULL, count);
+        }
+
+        // Record an indexed draw of 'count' indices into 'numVerts' vertices
+        void drawElements(PRIMITIVES prim, const Vertex inputVerts[], const Attributes inputAttrs[], const int & numVerts,
+                          const unsigned int indices[], const int & count)
+        {
+            record(prim, inputVerts, inputAttrs, numVerts, indices, count);
+        }
+
+        // Group draws by state before merging (reorders them)
+        void setSortByState(bool sort)
+        {
+            compiled = compiled && sort == sortByState;
+            sortByState = sort;
+        }
+
+        // Draws recorded and batches they compile to
+        int drawCount() const   { return (int)draws.size(); }
+        int batchCount()
+        {
+            if(!compiled)
+            {
+                compile();
+            }
+            return (int)batches.size();
+        }
+
+        // Replay everything into 'target'
+        void submit(Buffer2D<PIXEL> & target)
+        {
+            if(!compiled)
+            {
+                compile();
+            }
+
+            ViewportState savedView = GetViewportState();
+            CullState savedCull = GetCullState();
+            ClipState savedClip = GetClipState();
+            for(size_t b = 0; b < batches.size(); b++)
+            {
+                const Batch & batch = batches[b];
+                CommandState & state = states[batch.state];
+                GetViewportState() = state.view;
+                GetCullState() = state.cull;
+                GetClipState() = state.clip;
+                DrawElementsWith(batch.prim, target, &batchVerts[0], &batchAttrs[0], &batchIndices[batch.firstIndex], batch.count,
+                                 &state.uniforms, FragShaderAdapter(state.frag), VertShaderAdapter(state.vert), state.zBuf);
+            }
+            GetViewportState() = savedView;
+            GetCullState() = savedCull;
+            GetClipState() = savedClip;
+        }
+};
+
+#endif
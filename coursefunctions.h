@@ -1,4 +1,8 @@
 #include "definitions.h"
+#include "assets.h"
+#include "tiles.h"
+#include "life.h"
+#include <chrono>
 
 #ifndef COURSE_FUNCTIONS_H
 #define COURSE_FUNCTIONS_H
@@ -14,29 +18,19 @@
  * 
  * When you finish this activity be sure to 
  * uncomment these functions again!!!
+ *
+ * The simulation itself is LifeGrid (life.h); this
+ * only handles input, pacing and the upscaled view.
  **************************************************/
 void GameOfLife(Buffer2D<PIXEL> & target)
 {
         // 'Static's are initialized exactly once
         static bool isSetup = true;
         static bool holdDown = false;
-        static int w = target.width();
-        static int h = target.height();
         static int scaleFactor = 8;
-        static int gridW = 64;
-        static int gridH = 64; 
-        static int grid[64][64];
-        static int gridTmp[64][64];
-
-        // Setup small grid, temporary grid from previous iteration
-        for(int y = 0; y < gridH; y++)
-        {
-                for(int x = 0; x < gridW; x++)
-                {
-                        grid[y][x] = (target[y*scaleFactor][x*scaleFactor] == 0xffff0000) ? 1 : 0;
-                        gridTmp[y][x] = grid[y][x];
-                }
-        }
+        static double generationsPerSecond = 2.0;
+        static LifeGrid grid(target.width() / scaleFactor, target.height() / scaleFactor);
+        static std::chrono::steady_clock::time_point lastStep = std::chrono::steady_clock::now();
 
         //Parse for inputs
         SDL_Event e;
@@ -58,90 +52,58 @@ void GameOfLife(Buffer2D<PIXEL> & target)
                 }
                 if(holdDown && isSetup)
                 {
-                        // Clicking the mouse changes a pixel's color
+                        // Clicking the mouse flips a cell, window y runs down, frame rows up
                         SDL_GetMouseState(&mouseX, &mouseY);
-                        int gridX = mouseX / scaleFactor;
-                        int gridY = mouseY / scaleFactor;
-                        if(grid[gridY][gridX] == 1)
-                        {
-                                // Dead
-                                grid[gridY][gridX] = 0;
-                        }
-                        else
-                        {
-                                // Alive
-                                grid[gridY][gridX] = 1;
-                        }
+                        grid.toggle(mouseX / scaleFactor, (target.height() - 1 - mouseY) / scaleFactor);
                 }
         }
 
-
-        // Advance the simulation after pressing 'g'
+        // Advance the simulation after pressing 'g', catching up on the
+        // generations due since the last frame instead of sleeping
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
         if(!isSetup)
         {
-                // Your Code goes here
-
-                // Wait a half-second between iterations
-                SDL_Delay(500);
-        }
-
-
-        // Upscale/blit to screen
-        for(int y = 0; y < h; y++)
-        {
-                for(int x = 0; x < w; x++)
+                std::chrono::duration<double> interval(1.0 / generationsPerSecond);
+                for(int due = 0; now - lastStep >= interval && due < 8; due++)
                 {
-                        int yScal = y/scaleFactor;
-                        int xScal = x/scaleFactor;
-                        if(grid[yScal][xScal] == 0)
-                        {
-                                // Dead Color
-                                target[y][x] = 0xff000000;
-                        }
-                        else
-                        {
-                                // Alive color
-                                target[y][x] = 0xffff0000;
-                        }
+                        grid.step(GetTileRenderer().workers());
+                        lastStep += std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
                 }
         }
+        if(isSetup || now - lastStep > std::chrono::seconds(1))
+        {
+                lastStep = now;
+        }
+
+        // Upscale/blit to screen
+        grid.draw(target, 0, 0, scaleFactor);
 }
 
 /***************************************************
  * Create a 3D View like in a CAD program
- * NOTE: Assumes that the resolution is an even 
- * value in both dimensions.
+ * Each view is a viewport on one quadrant of
+ * 'target' and draws straight into it. With more
+ * than one raster thread the four views are binned
+ * together and rasterize concurrently when the 
+ * frame is finished.
  **************************************************/
 void CADView(Buffer2D<PIXEL> & target)
 {
-        // Each CAD Quadrant
-        static int halfWid = target.width()/2;
-        static int halfHgt = target.height()/2;
-        static Buffer2D<PIXEL> topLeft(halfWid, halfHgt);
-        static Buffer2D<PIXEL> topRight(halfWid, halfHgt);
-        static Buffer2D<PIXEL> botLeft(halfWid, halfHgt);
-        static Buffer2D<PIXEL> botRight(halfWid, halfHgt);
-
-
-        // Your code goes here 
-        // Feel free to copy from other test functions to get started!
+        // Each CAD Quadrant: top left, top right, bottom left, bottom right
+        int halfWid = target.width()/2;
+        int halfHgt = target.height()/2;
+        int quadrants[4][2] = {{0, halfHgt}, {halfWid, halfHgt}, {0, 0}, {halfWid, 0}};
 
-
-        // Blit four panels to target
-        int yStartSrc = 0;
-        int xStartSrc = 0;
-        int yLimitSrc = topLeft.height();
-        int xLimitSrc = topLeft.width();
-        for(int ySrc = yStartSrc; ySrc < yLimitSrc; ySrc++)
+        for(int q = 0; q < 4; q++)
         {
-                for(int xSrc = xStartSrc; xSrc < xLimitSrc; xSrc++)
-                {
-                        target[ySrc][xSrc]                 = botLeft[ySrc][xSrc];
-                        target[ySrc][xSrc+halfWid]         = botRight[ySrc][xSrc];
-                        target[ySrc+halfHgt][xSrc]         = topLeft[ySrc][xSrc];
-                        target[ySrc+halfHgt][xSrc+halfWid] = topRight[ySrc][xSrc];
-                }
+                SetViewport(quadrants[q][0], quadrants[q][1], halfWid, halfHgt);
+
+                // Your code goes here 
+                // Feel free to copy from other test functions to get started!
         }
+
+        // Later draws get the whole target back
+        SetViewport(0, 0, 0, 0);
 }
 
 /***************************************************
@@ -253,7 +215,7 @@ void TestDrawFragments(Buffer2D<PIXEL> & target)
         double coordinates[3][2] = { {1,0}, {1,1}, {0,1} };
         // Your texture coordinate code goes here for 'imageAttributes'
 
-        BufferImage myImage("image.bmp");
+        // Your image code goes here, GetAssetCache().image("image.bmp") loads it once
         // Provide an image in this directory that you would like to use (powers of 2 dimensions)
 
         Attributes imageUniforms;
@@ -297,7 +259,7 @@ void TestDrawPerspectiveCorrect(Buffer2D<PIXEL> & target)
         double coordinates[4][2] = { {0/divA,0/divA}, {1/divA,0/divA}, {1/divB,1/divB}, {0/divB,1/divB} };
         // Your texture coordinate code goes here for 'imageAttributesA, imageAttributesB'
 
-        BufferImage myImage("checker.bmp");
+        // Your image code goes here, GetAssetCache().texture("checker.bmp", WRAP_CLAMP) loads and mipmaps it once
         // Ensure the checkboard image is in this directory
 
         Attributes imageUniforms;
@@ -390,8 +352,8 @@ void TestPipeline(Buffer2D<PIXEL> & target)
         //              vi)  camZ
         //      To incorporate a view transform (add movement)
         
-        static Buffer2D<double> zBuf(target.width(), target.height());
-        // Will need to be cleared every frame, like the screen
+        static DepthBuffer zBuf(target.width(), target.height());
+        ClearDepth(zBuf);
 
         /**************************************************
         * 1. Image quad (2 TRIs) Code (texture interpolated)
@@ -401,22 +363,15 @@ void TestPipeline(Buffer2D<PIXEL> & target)
                           {20, 20, 50, 1},
                           {-20,20, 50, 1}};
 
-        Vertex verticesImgA[3];
-        Attributes imageAttributesA[3];
-        verticesImgA[0] = quad[0];
-        verticesImgA[1] = quad[1];
-        verticesImgA[2] = quad[2];
-
-        Vertex verticesImgB[3];        
-        Attributes imageAttributesB[3];
-        verticesImgB[0] = quad[2];
-        verticesImgB[1] = quad[3];
-        verticesImgB[2] = quad[0];
+        // Two triangles sharing the quad's diagonal, each corner is shaded once
+        unsigned int quadIndices[] = {0, 1, 2,
+                                      2, 3, 0};
+        Attributes quadAttributes[4];
 
         double coordinates[4][2] = { {0,0}, {1,0}, {1,1}, {0,1} };
-        // Your texture coordinate code goes here for 'imageAttributesA, imageAttributesB'
+        // Your texture coordinate code goes here for 'quadAttributes'
 
-        BufferImage myImage("checker.bmp");
+        // Your image code goes here, GetAssetCache().texture("checker.bmp", WRAP_CLAMP) loads and mipmaps it once
         // Ensure the checkboard image is in this directory, you can use another image though
 
         Attributes imageUniforms;
@@ -430,9 +385,8 @@ void TestPipeline(Buffer2D<PIXEL> & target)
         // NOTE: This must include the at least the 
         // projection matrix if not more transformations 
                 
-        // Draw image triangle 
-        DrawPrimitive(TRIANGLE, target, verticesImgA, imageAttributesA, &imageUniforms, &fragImg, &vertImg, &zBuf);
-        DrawPrimitive(TRIANGLE, target, verticesImgB, imageAttributesB, &imageUniforms, &fragImg, &vertImg, &zBuf);
+        // Draw image quad
+        DrawElements(TRIANGLE, target, quad, quadAttributes, quadIndices, 6, &imageUniforms, &fragImg, &vertImg, &zBuf);
 
         // NOTE: To test the Z-Buffer additinonal draw calls/geometry need to be called into this scene
 }
@@ -0,0 +1,86 @@
+#include "definitions.h"
+#include "stats.h"
+#include "tiles.h"
+
+#ifndef CULL_H
+#define CULL_H
+
+/******************************************************
+ * CULL_STATE:
+ * Pipeline state for the culling stage. Facing is only
+ * tested when 'mode' asks for it, the earlier test
+ * scenes draw both windings. Degenerate, off-screen
+ * and sample-less triangles are always dropped since
+ * they could never produce a fragment.
+ *****************************************************/
+struct CullState
+{
+    CULL_MODES mode;
+    WINDINGS frontFace;
+
+    CullState() : mode(CULL_NONE), frontFace(WINDING_CCW)
+    {
+    }
+};
+
+inline CullState & GetCullState()
+{
+    static CullState state;
+    return state;
+}
+
+/******************************************************
+ * Screen-space triangle test against the pixels the
+ * draw may write. Returns NUM_CULL_REASONS when the 
+ * triangle must be rasterized, otherwise why it was
+ * rejected. Cheapest tests run first. Works on the 
+ * snapped vertices the rasterizer and binner see, so a
+ * triangle is only dropped when they would draw none
+ * of it.
+ *****************************************************/
+inline CULL_REASONS CullTriangle(const RasterVertex* v, const ScreenRect & bounds, const CullState & state)
+{
+    // Twice the signed area in subpixels, positive when counter-clockwise
+    int64_t area = (int64_t)(v[1].x - v[0].x) * (v[2].y - v[0].y) - (int64_t)(v[2].x - v[0].x) * (v[1].y - v[0].y);
+    if(area == 0)
+    {
+        return CULLED_DEGENERATE;
+    }
+
+    if(state.mode != CULL_NONE)
+    {
+        bool front = (area > 0) == (state.frontFace == WINDING_CCW);
+        if(state.mode == CULL_FRONT_AND_BACK ||
+           (state.mode == CULL_BACK && !front) ||
+           (state.mode == CULL_FRONT && front))
+        {
+            return CULLED_BACKFACE;
+        }
+    }
+
+    int minX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+    int minY = std::min(v[0].y, std::min(v[1].y, v[2].y));
+    int maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+    int maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+    if(maxX <= bounds.x0 * SUBPIXEL_ONE || maxY <= bounds.y0 * SUBPIXEL_ONE ||
+       minX >= bounds.x1 * SUBPIXEL_ONE || minY >= bounds.y1 * SUBPIXEL_ONE)
+    {
+        return CULLED_OUTSIDE;
+    }
+
+    // No pixel center inside the bounds on some axis, same range as 
+    // RasterizeTriangle walks
+    const int half = SUBPIXEL_ONE / 2;
+    int x0 = std::max((minX + half - 1) >> SUBPIXEL_BITS, bounds.x0);
+    int y0 = std::max((minY + half - 1) >> SUBPIXEL_BITS, bounds.y0);
+    int x1 = std::min(((maxX - half) >> SUBPIXEL_BITS) + 1, bounds.x1);
+    int y1 = std::min(((maxY - half) >> SUBPIXEL_BITS) + 1, bounds.y1);
+    if(x0 >= x1 || y0 >= y1)
+    {
+        return CULLED_NO_SAMPLES;
+    }
+
+    return NUM_CULL_REASONS;
+}
+
+#endif
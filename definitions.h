@@ -2,7 +2,16 @@
 #include "SDL2/SDL.h"
 #include "stdlib.h"
 #include "stdio.h"
+#include "string.h"
+#include "stdint.h"
+#include "stddef.h"
 #include "math.h"
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAS_SSE2 1
+#include <emmintrin.h>
+#endif
 
 #ifndef DEFINITIONS_H
 #define DEFINITIONS_H
@@ -23,7 +32,7 @@
 #define MAX3(A,B,C) MAX((MAX(A,B)),C)
 
 // Max # of vertices after clipping
-#define MAX_VERTICES 8 
+#define MAX_VERTICES 12
 
 /******************************************************
  * Types of primitives our pipeline will render.
@@ -35,6 +44,25 @@ enum PRIMITIVES
     POINT
 };
 
+/***************************************************
+ * Which facing of triangle the pipeline culls, and
+ * the screen-space winding of a front face (+y up,
+ * as frames are stored bottom-up).
+ **************************************************/
+enum CULL_MODES
+{
+    CULL_NONE,
+    CULL_BACK,
+    CULL_FRONT,
+    CULL_FRONT_AND_BACK
+};
+
+enum WINDINGS
+{
+    WINDING_CCW,
+    WINDING_CW
+};
+
 /****************************************************
  * Describes a geometric point in 3D space. 
  ****************************************************/
@@ -46,99 +74,378 @@ struct Vertex
     double w;
 };
 
+/******************************************************
+ * ALIGNED_MALLOC / ALIGNED_FREE:
+ * Portable aligned allocation for buffer storage. The
+ * raw block address is stashed just before the aligned
+ * pointer so 'alignedFree' can hand it back to 'free'.
+ *****************************************************/
+#define BUFFER_ALIGN 64
+
+inline void* alignedMalloc(size_t bytes, size_t alignment = BUFFER_ALIGN)
+{
+    void* raw = malloc(bytes + alignment + sizeof(void*));
+    if(raw == NULL)
+    {
+        return NULL;
+    }
+    uintptr_t start = (uintptr_t)raw + sizeof(void*);
+    uintptr_t aligned = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    ((void**)aligned)[-1] = raw;
+    return (void*)aligned;
+}
+
+inline void alignedFree(void* ptr)
+{
+    if(ptr != NULL)
+    {
+        free(((void**)ptr)[-1]);
+    }
+}
+
 /******************************************************
  * BUFFER_2D:
  * Used for 2D buffers including render targets, images
  * and depth buffers. Can be described as frames or 
  * 2D arrays ot type 'T' encapsulated in an object.
+ *
+ * Storage is one contiguous, BUFFER_ALIGN aligned block.
+ * Each row is padded out to 'pitch()' elements so every
+ * row starts aligned. A negative pitch describes a
+ * bottom-up view of foreign memory (see BufferImage).
+ * 'T' is expected to be trivially copyable.
  *****************************************************/
 template <class T>
 class Buffer2D 
 {
     protected:
-        T** grid;
+        T* grid;        // Address of row 0
+        T* block;       // Owned allocation, NULL for views of foreign memory
         int w;
         int h;
+        int p;          // Distance between rows, in elements
+
+        // Row length in elements, padded so each row stays aligned
+        static int alignedPitch(const int & wid)
+        {
+            size_t bytes = sizeof(T) * wid;
+            size_t padded = (bytes + BUFFER_ALIGN - 1) & ~(size_t)(BUFFER_ALIGN - 1);
+            return (padded % sizeof(T) == 0) ? (int)(padded / sizeof(T)) : wid;
+        }
 
         // Private intialization setup
         void setupInternal()
         {
-            // Allocate pointers for column references
-            grid = (T**)malloc(sizeof(T*) * h);                
+            p = alignedPitch(w);
+            block = (T*)alignedMalloc(sizeof(T) * p * h);
+            grid = block;
+        }
+
+        // Release owned storage, if any
+        void releaseInternal()
+        {
+            alignedFree(block);
+            block = NULL;
+            grid = NULL;
+        }
+
+        // Row-by-row copy from a same-sized buffer
+        void copyRows(const Buffer2D & ib)
+        {
             for(int r = 0; r < h; r++)
             {
-                grid[r] = (T*)malloc(sizeof(T) * w);
+                memcpy((*this)[r], ib[r], sizeof(T) * w);
+            }
+        }
+
+        // Take over another buffer's storage
+        void stealFrom(Buffer2D & ib)
+        {
+            grid = ib.grid;
+            block = ib.block;
+            w = ib.w;
+            h = ib.h;
+            p = ib.p;
+            ib.grid = NULL;
+            ib.block = NULL;
+            ib.w = 0;
+            ib.h = 0;
+            ib.p = 0;
+        }
+
+        // Writes 'count' copies of 'value' starting at 'dst'
+        static void fillSpan(T* dst, size_t count, const T & value)
+        {
+            // Byte-uniform values (0, all ones, ...) are a plain memset
+            const unsigned char* bytes = (const unsigned char*)&value;
+            bool uniform = true;
+            for(size_t b = 1; b < sizeof(T); b++)
+            {
+                uniform = uniform && bytes[b] == bytes[0];
+            }
+            if(uniform)
+            {
+                memset(dst, bytes[0], sizeof(T) * count);
+                return;
+            }
+
+#ifdef HAS_SSE2
+            // 32-bit values go out 16 bytes per store once aligned
+            if(sizeof(T) == 4)
+            {
+                while(count > 0 && ((uintptr_t)dst & 15) != 0)
+                {
+                    *dst++ = value;
+                    count--;
+                }
+                uint32_t bits;
+                memcpy(&bits, &value, 4);
+                __m128i wide = _mm_set1_epi32((int)bits);
+                for(; count >= 16; count -= 16, dst += 16)
+                {
+                    _mm_store_si128((__m128i*)dst, wide);
+                    _mm_store_si128((__m128i*)dst + 1, wide);
+                    _mm_store_si128((__m128i*)dst + 2, wide);
+                    _mm_store_si128((__m128i*)dst + 3, wide);
+                }
+                for(; count >= 4; count -= 4, dst += 4)
+                {
+                    _mm_store_si128((__m128i*)dst, wide);
+                }
+            }
+#endif
+            for(size_t i = 0; i < count; i++)
+            {
+                dst[i] = value;
             }
         }
 
         // Empty Constructor
-        Buffer2D()
+        Buffer2D() : grid(NULL), block(NULL), w(0), h(0), p(0)
         {}
 
     public:
         // Free dynamic memory
         ~Buffer2D()
         {
-            // De-Allocate pointers for column references
-            for(int r = 0; r < h; r++)
-            {
-                free(grid[r]);
-            }
-            free(grid);
+            releaseInternal();
         }
 
         // Size-Specified constructor, no data
-        Buffer2D(const int & wid, const int & hgt)
+        Buffer2D(const int & wid, const int & hgt) : grid(NULL), block(NULL), w(wid), h(hgt), p(0)
         {
-            h = hgt;
-            w = wid;
             setupInternal();
             zeroOut();
         }
 
-        // Assignment constructor
-        Buffer2D& operator=(const Buffer2D & ib)
+        // Copy constructor, always produces an owned top-down copy
+        Buffer2D(const Buffer2D & ib) : grid(NULL), block(NULL), w(ib.w), h(ib.h), p(0)
         {
-            w = ib.width();
-            h = ib.height();
             setupInternal();
-            for(int r = 0; r < h; r++)
+            copyRows(ib);
+        }
+
+        // Move constructor
+        Buffer2D(Buffer2D && ib) : grid(NULL), block(NULL), w(0), h(0), p(0)
+        {
+            stealFrom(ib);
+        }
+
+        // Assignment operator
+        Buffer2D& operator=(const Buffer2D & ib)
+        {
+            if(this == &ib)
             {
-                for(int c = 0; c < w; c++)
-                {
-                    grid[r][c] = ib[r][c];
-                }
+                return *this;
+            }
+            if(block == NULL || w != ib.w || h != ib.h)
+            {
+                releaseInternal();
+                w = ib.w;
+                h = ib.h;
+                setupInternal();
             }
+            copyRows(ib);
+            return *this;
+        }
+
+        // Move assignment operator
+        Buffer2D& operator=(Buffer2D && ib)
+        {
+            if(this != &ib)
+            {
+                releaseInternal();
+                stealFrom(ib);
+            }
+            return *this;
         }
 
         // Set each member to zero 
         void zeroOut()
         {
+            if(p > 0 && grid == block)
+            {
+                memset(grid, 0, sizeof(T) * p * h);
+                return;
+            }
             for(int r = 0; r < h; r++)
             {
-                for(int c = 0; c < w; c++)
-                {
-                    grid[r][c] = 0;
-                }
+                memset((*this)[r], 0, sizeof(T) * w);
+            }
+        }
+
+        // Set every member to 'value', one pass over the whole block when contiguous
+        void fill(const T & value)
+        {
+            if(p > 0 && grid == block)
+            {
+                fillSpan(grid, (size_t)p * h, value);
+                return;
+            }
+            for(int r = 0; r < h; r++)
+            {
+                fillSpan((*this)[r], w, value);
+            }
+        }
+
+        // Set members in [x0, x1) x [y0, y1) to 'value'
+        void fillRect(const int & x0, const int & y0, const int & x1, const int & y1, const T & value)
+        {
+            for(int r = y0; r < y1; r++)
+            {
+                fillSpan((*this)[r] + x0, x1 - x0, value);
             }
         }
 
         // Width, height
-        const int & width()  { return w; }
-        const int & height() { return h; }
+        const int & width() const  { return w; }
+        const int & height() const { return h; }
+
+        // Raw view: address of row 0 and the row stride in elements
+        T* data()              { return grid; }
+        const T* data() const  { return grid; }
+        const int & pitch() const { return p; }
 
         // The frequented operator for grabbing pixels
-        inline T* & operator[] (int i)
+        inline T* operator[] (int i)
+        {
+            return grid + (ptrdiff_t)i * p;
+        }
+
+        inline const T* operator[] (int i) const
         {
-            return grid[i];
+            return grid + (ptrdiff_t)i * p;
         }
 };
 
 
+/****************************************************
+ * DEPTH_BUFFER:
+ * 32-bit float depth buffer holding interpolated 1/w
+ * (larger is nearer, 0 is empty). Alongside the 
+ * per-pixel values it keeps a coarse bound for every 
+ * DEPTH_BLOCK x DEPTH_BLOCK block of pixels:
+ *      far  - no pixel in the block is farther
+ *      near - no pixel in the block is nearer
+ * The rasterizer uses them to drop hidden blocks 
+ * before coverage, and to store the depth of blocks
+ * entirely in front without per-pixel compares.
+ *
+ * A lazy clear from the tile renderer is recorded 
+ * here, per tile, so it stays with the buffer: each
+ * tile is reset on its first touch by whichever draw
+ * reaches it.
+ ***************************************************/
+#define DEPTH_BLOCK 4
+
+// Relative slack on the coarse bounds before a block skips its compares
+#define DEPTH_BOUND_MARGIN 1e-5f
+
+class DepthBuffer : public Buffer2D<float>
+{
+    protected:
+        Buffer2D<float> coarseFar;
+        Buffer2D<float> coarseNear;
+
+        // Deferred clear: flags of the 'pendingTile' sized tiles still to reset
+        std::vector<unsigned char> pending;
+        int pendingTile;
+        int pendingAcross;
+
+    public:
+        DepthBuffer(const int & wid, const int & hgt) 
+            : Buffer2D<float>(wid, hgt),
+              coarseFar((wid + DEPTH_BLOCK - 1) / DEPTH_BLOCK, (hgt + DEPTH_BLOCK - 1) / DEPTH_BLOCK),
+              coarseNear((wid + DEPTH_BLOCK - 1) / DEPTH_BLOCK, (hgt + DEPTH_BLOCK - 1) / DEPTH_BLOCK),
+              pendingTile(0), pendingAcross(0)
+        {}
+
+        // Reset every pixel and block to empty
+        void clear()
+        {
+            zeroOut();
+            coarseFar.zeroOut();
+            coarseNear.zeroOut();
+            pending.clear();
+        }
+
+        // Reset [x0, x1) x [y0, y1), which must be DEPTH_BLOCK aligned
+        void clearRect(const int & x0, const int & y0, const int & x1, const int & y1)
+        {
+            fillRect(x0, y0, x1, y1, 0.0f);
+            int bx1 = (x1 + DEPTH_BLOCK - 1) / DEPTH_BLOCK;
+            int by1 = (y1 + DEPTH_BLOCK - 1) / DEPTH_BLOCK;
+            coarseFar.fillRect(x0 / DEPTH_BLOCK, y0 / DEPTH_BLOCK, bx1, by1, 0.0f);
+            coarseNear.fillRect(x0 / DEPTH_BLOCK, y0 / DEPTH_BLOCK, bx1, by1, 0.0f);
+        }
+
+        // Defer the clear to the first touch of each 'tile' x 'tile' tile
+        void deferClear(const int & tile)
+        {
+            pendingTile = tile;
+            pendingAcross = (width() + tile - 1) / tile;
+            pending.assign(pendingAcross * ((height() + tile - 1) / tile), 1);
+        }
+
+        // Tile size of the deferred clear, 0 if none is pending
+        int deferredTile() const { return pending.empty() ? 0 : pendingTile; }
+
+        // Perform the deferred clear of tile 'b', if still pending. 
+        // Distinct tiles may be touched in parallel.
+        void touchTile(const int & b)
+        {
+            if(b < (int)pending.size() && pending[b])
+            {
+                int x0 = (b % pendingAcross) * pendingTile;
+                int y0 = (b / pendingAcross) * pendingTile;
+                int x1 = x0 + pendingTile < width() ? x0 + pendingTile : width();
+                int y1 = y0 + pendingTile < height() ? y0 + pendingTile : height();
+                clearRect(x0, y0, x1, y1);
+                pending[b] = 0;
+            }
+        }
+
+        // Perform every deferred clear still pending
+        void resolveClears()
+        {
+            for(int b = 0; b < (int)pending.size(); b++)
+            {
+                touchTile(b);
+            }
+            pending.clear();
+        }
+
+        // Coarse bounds of the block holding pixel (x, y)
+        float & blockFar(const int & x, const int & y)  { return coarseFar[y / DEPTH_BLOCK][x / DEPTH_BLOCK]; }
+        float & blockNear(const int & x, const int & y) { return coarseNear[y / DEPTH_BLOCK][x / DEPTH_BLOCK]; }
+};
+
 /****************************************************
  * BUFFER_IMAGE:
  * PIXEL (Uint32) specific Buffer2D class with .BMP 
- * loading/management features.
+ * loading/management features. Rows are viewed 
+ * bottom-up straight out of the SDL_Surface, so 
+ * row 0 is the last line in memory.
  ***************************************************/
 class BufferImage : public Buffer2D<PIXEL>
 {
@@ -149,27 +456,25 @@ class BufferImage : public Buffer2D<PIXEL>
         // Private intialization setup
         void setupInternal()
         {
-            // Allocate pointers for column references
-            h = img->h;
-            w = img->w;
-            grid = (PIXEL**)malloc(sizeof(PIXEL*) * h);                
-
-            PIXEL* row = (PIXEL*)img->pixels;
-            row += (w*h);
-            for(int i = 0; i < h; i++)
+            if(img == NULL)
             {
-                grid[i] = row;
-                row -= w;                    
+                w = h = p = 0;
+                grid = NULL;
+                return;
             }
+
+            // Point row 0 at the last scanline and walk upwards
+            h = img->h;
+            w = img->w;
+            int surfacePitch = img->pitch / sizeof(PIXEL);
+            grid = (PIXEL*)img->pixels + (ptrdiff_t)(h - 1) * surfacePitch;
+            p = -surfacePitch;
         }
 
     public:
         // Free dynamic memory
         ~BufferImage()
         {
-            // De-Allocate pointers for column references
-            free(grid);
-
             // De-Allocate this image plane if necessary
             if(ourSurfaceInstance)
             {
@@ -177,26 +482,66 @@ class BufferImage : public Buffer2D<PIXEL>
             }
         }
 
-        // Assignment constructor
+        // Copy constructor, views the same surface without owning it
+        BufferImage(const BufferImage & ib) : Buffer2D<PIXEL>()
+        {
+            img = ib.img;
+            ourSurfaceInstance = false;
+            setupInternal();
+        }
+
+        // Move constructor, takes over surface ownership
+        BufferImage(BufferImage && ib) : Buffer2D<PIXEL>()
+        {
+            img = ib.img;
+            ourSurfaceInstance = ib.ourSurfaceInstance;
+            setupInternal();
+            ib.img = NULL;
+            ib.ourSurfaceInstance = false;
+            ib.setupInternal();
+        }
+
+        // Assignment operator, views the same surface without owning it
         BufferImage& operator=(const BufferImage & ib)
         {
+            if(this == &ib)
+            {
+                return *this;
+            }
+            if(ourSurfaceInstance)
+            {
+                SDL_FreeSurface(img);
+            }
             img = ib.img;
-            w = ib.w;
-            h = ib.h;
             ourSurfaceInstance = false;
-            grid = (PIXEL**)malloc(sizeof(PIXEL*) * img->h);                
-            for(int i = 0; i < img->w; i++)
+            setupInternal();
+            return *this;
+        }
+
+        // Move assignment operator
+        BufferImage& operator=(BufferImage && ib)
+        {
+            if(this == &ib)
             {
-                grid[i] = ib.grid[i];
+                return *this;
             }
+            if(ourSurfaceInstance)
+            {
+                SDL_FreeSurface(img);
+            }
+            img = ib.img;
+            ourSurfaceInstance = ib.ourSurfaceInstance;
+            setupInternal();
+            ib.img = NULL;
+            ib.ourSurfaceInstance = false;
+            ib.setupInternal();
+            return *this;
         }
 
         // Constructor based on instantiated SDL_Surface
         BufferImage(SDL_Surface* src) 
         { 
             img = src; 
-            w = src->w;
-            h = src->h;
             ourSurfaceInstance = false;
             setupInternal();
         }
@@ -205,11 +550,15 @@ class BufferImage : public Buffer2D<PIXEL>
         BufferImage(const char* path) 
         {
             ourSurfaceInstance = true;
+            img = NULL;
             SDL_Surface* tmp = SDL_LoadBMP(path);      
-            SDL_PixelFormat* format = SDL_AllocFormat(SDL_PIXELFORMAT_ARGB8888);
-            img = SDL_ConvertSurface(tmp, format, 0);
-            SDL_FreeSurface(tmp);
-            SDL_FreeFormat(format);
+            if(tmp != NULL)
+            {
+                SDL_PixelFormat* format = SDL_AllocFormat(SDL_PIXELFORMAT_ARGB8888);
+                img = SDL_ConvertSurface(tmp, format, 0);
+                SDL_FreeSurface(tmp);
+                SDL_FreeFormat(format);
+            }
             setupInternal();
         }
 };
@@ -217,22 +566,102 @@ class BufferImage : public Buffer2D<PIXEL>
 /***************************************************
  * ATTRIBUTES (shadows OpenGL VAO, VBO)
  * The attributes associated with a rendered 
- * primitive as a whole OR per-vertex. Will be 
- * designed/implemented by the programmer. 
+ * primitive as a whole OR per-vertex. Laid out as a
+ * fixed block of MAX_ATTRIBUTES float slots (colors,
+ * texture coordinates, ...) the rasterizer 
+ * interpolates with SIMD, plus one pointer slot for
+ * uniforms such as a texture or a matrix.
+ *
+ * Slots are interpolated perspective-correct: the 
+ * rasterizer expects per-vertex slots pre-multiplied
+ * by the vertex's w (which holds 1/w after 
+ * normalization) and divides by the interpolated w.
+ **************************************************/
+#define MAX_ATTRIBUTES 8
+
+/***************************************************
+ * ATTRIBUTE_GRADIENTS
+ * Screen-space derivatives of every slot, taken by
+ * the rasterizer as differences across the quad of
+ * the fragment being shaded (texture level 
+ * selection, ...).
  **************************************************/
+struct AttributeGradients
+{
+    alignas(16) float ddx[MAX_ATTRIBUTES];
+    alignas(16) float ddy[MAX_ATTRIBUTES];
+};
+
 class Attributes
 {      
     public:
+        alignas(16) float value[MAX_ATTRIBUTES];
+        int numMembers;
+        void* ptrImg;
+        const AttributeGradients* grad;     // Only set on fragments, else NULL
+
         // Obligatory empty constructor
-        Attributes() {}
+        Attributes() : numMembers(0), ptrImg(NULL), grad(NULL)
+        {
+            for(int i = 0; i < MAX_ATTRIBUTES; i++)
+            {
+                value[i] = 0;
+            }
+        }
 
         // Needed by clipping (linearly interpolated Attributes between two others)
         Attributes(const Attributes & first, const Attributes & second, const double & valueBetween)
         {
-            // Your code goes here when clipping is implemented
+            float t = (float)valueBetween;
+            for(int i = 0; i < MAX_ATTRIBUTES; i++)
+            {
+                value[i] = first.value[i] + (second.value[i] - first.value[i]) * t;
+            }
+            numMembers = first.numMembers;
+            ptrImg = first.ptrImg;
+            grad = NULL;
+        }
+
+        // Append a slot
+        void insertDbl(const double & d)
+        {
+            value[numMembers++] = (float)d;
         }
+
+        // Attach a uniform pointer (texture, matrix, ...), shaders only read through it
+        void insertPtr(const void* ptr)
+        {
+            ptrImg = const_cast<void*>(ptr);
+        }
+
+        float & operator[](const int & i)              { return value[i]; }
+        const float & operator[](const int & i) const  { return value[i]; }
 };	
 
+/***************************************************
+ * FRAGMENT_QUAD
+ * A 2x2 block of fragments the rasterizer shades 
+ * together. Lane (r*2 + c) is pixel (x + c, y + r).
+ * Lanes outside 'mask' are helpers: they are 
+ * interpolated like the rest, so differences across 
+ * the quad give every slot's derivatives, but their
+ * colors are discarded. 'color' holds the target 
+ * pixels of covered lanes on entry and the shaded 
+ * results on exit. Every lane's 'grad' points at 
+ * the quad's shared 'grad'.
+ **************************************************/
+#define QUAD_LANES 4
+
+struct FragmentQuad
+{
+    Attributes frag[QUAD_LANES];
+    AttributeGradients grad;
+    alignas(16) PIXEL color[QUAD_LANES];
+    int mask;
+    int x;
+    int y;
+};
+
 // Example of a fragment shader
 void DefaultFragShader(PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms)
 {
@@ -285,7 +714,8 @@ void DefaultVertShader(Vertex & vertOut, Attributes & attrOut, const Vertex & ve
  * Encapsulates a programmer-specified callback
  * function for transforming vertices and per-vertex
  * attributes. See 'DefaultVertShader' for a pass-through
- * shader example.
+ * shader example. The callback runs once per vertex on 
+ * the drawing thread, never concurrently.
  *********************************************************/
 class VertexShader
 {
@@ -312,6 +742,138 @@ class VertexShader
         }
 };
 
+/**********************************************************
+ * SHADER ADAPTERS
+ * The templated draw path (DrawPrimitiveWith, 
+ * DrawElementsWith) takes shaders as functor or lambda 
+ * types so the raster loop is compiled per shader and the
+ * shading code inlines into it. Fragment functors take
+ *      (PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms)
+ * and vertex functors take
+ *      (Vertex & vertOut, Attributes & attrOut, const Vertex & vertIn, const Attributes & vertAttr, const Attributes & uniforms)
+ * Functors are copied into queued work, so they must be
+ * trivially copyable and fit in MAX_SHADER_STATE bytes
+ * (capture by pointer rather than by value).
+ *
+ * A fragment functor may also provide a quad entry point
+ *      void shadeQuad(FragmentQuad & quad, const Attributes & uniforms) const
+ * which the rasterizer then calls once per 2x2 quad in
+ * place of four per-pixel calls.
+ *
+ * Vertex functors run on the drawing thread unless they
+ * declare
+ *      static const bool concurrent = true;
+ * which lets large arrays be shaded across the worker 
+ * pool; they must then be safe to call concurrently.
+ *
+ * FragShaderAdapter/VertShaderAdapter run the callback 
+ * classes above through that path; StaticFragShader and
+ * StaticVertShader bind a free function at compile time.
+ *********************************************************/
+#define MAX_SHADER_STATE 32
+
+struct FragShaderAdapter
+{
+    void (*FragShader)(PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms);
+
+    FragShaderAdapter(const FragmentShader* const frag)
+    {
+        FragShader = frag != NULL ? frag->FragShader : DefaultFragShader;
+    }
+
+    inline void operator()(PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms) const
+    {
+        FragShader(fragment, vertAttr, uniforms);
+    }
+};
+
+struct VertShaderAdapter
+{
+    void (*VertShader)(Vertex & vertOut, Attributes & attrOut, const Vertex & vertIn, const Attributes & vertAttr, const Attributes & uniforms);
+
+    VertShaderAdapter(const VertexShader* const vert)
+    {
+        VertShader = vert != NULL ? vert->VertShader : DefaultVertShader;
+    }
+
+    inline void operator()(Vertex & vertOut, Attributes & attrOut, const Vertex & vertIn, const Attributes & vertAttr, const Attributes & uniforms) const
+    {
+        VertShader(vertOut, attrOut, vertIn, vertAttr, uniforms);
+    }
+};
+
+template <void (*Shader)(PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms)>
+struct StaticFragShader
+{
+    inline void operator()(PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms) const
+    {
+        Shader(fragment, vertAttr, uniforms);
+    }
+};
+
+template <void (*Shader)(Vertex & vertOut, Attributes & attrOut, const Vertex & vertIn, const Attributes & vertAttr, const Attributes & uniforms)>
+struct StaticVertShader
+{
+    inline void operator()(Vertex & vertOut, Attributes & attrOut, const Vertex & vertIn, const Attributes & vertAttr, const Attributes & uniforms) const
+    {
+        Shader(vertOut, attrOut, vertIn, vertAttr, uniforms);
+    }
+};
+
+/**********************************************************
+ * CONCURRENT_VERT_SHADER
+ * True if vertex functor 'VertT' opted in to being 
+ * called from several threads at once.
+ *********************************************************/
+template <class VertT>
+inline auto ConcurrentVertShader(const VertT &, int) -> decltype(VertT::concurrent, bool())
+{
+    return VertT::concurrent;
+}
+
+template <class VertT>
+inline bool ConcurrentVertShader(const VertT &, long)
+{
+    return false;
+}
+
+/**********************************************************
+ * SHADE_QUAD
+ * Runs a fragment functor over one quad: its 'shadeQuad'
+ * entry point when it has one, otherwise the per-pixel 
+ * call on each covered lane.
+ *********************************************************/
+template <class FragT>
+inline auto ShadeQuad(const FragT & frag, FragmentQuad & quad, const Attributes & uniforms, int) -> decltype(frag.shadeQuad(quad, uniforms), void())
+{
+    frag.shadeQuad(quad, uniforms);
+}
+
+template <class FragT>
+inline void ShadeQuad(const FragT & frag, FragmentQuad & quad, const Attributes & uniforms, long)
+{
+    for(int lane = 0; lane < QUAD_LANES; lane++)
+    {
+        if((quad.mask >> lane) & 1)
+        {
+            frag(quad.color[lane], quad.frag[lane], uniforms);
+        }
+    }
+}
+
+template <class FragT>
+inline void ShadeQuad(const FragT & frag, FragmentQuad & quad, const Attributes & uniforms)
+{
+    ShadeQuad(frag, quad, uniforms, 0);
+}
+
+/****************************************
+ * VERTICES_PER_PRIMITIVE
+ * Vertex count of one 'prim', see 
+ * pipeline.cpp.
+ ***************************************/
+int VerticesPerPrimitive(PRIMITIVES prim);
+
 // Stub for Primitive Drawing function
 /****************************************
  * DRAW_PRIMITIVE
@@ -324,6 +886,139 @@ void DrawPrimitive(PRIMITIVES prim,
                    Attributes* const uniforms = NULL,
                    FragmentShader* const frag = NULL,
                    VertexShader* const vert = NULL,
-                   Buffer2D<double>* zBuf = NULL);             
+                   DepthBuffer* zBuf = NULL);             
+
+/****************************************
+ * DRAW_ELEMENTS
+ * Indexed draw of 'count' indices (or 
+ * the first 'count' vertices when 
+ * 'indices' is NULL), see pipeline.cpp.
+ * Every index other than 
+ * PRIMITIVE_RESTART must name an entry
+ * of 'inputVerts' and 'inputAttrs'; a
+ * restart drops the primitive it cuts.
+ ***************************************/
+#define PRIMITIVE_RESTART 0xffffffffu
+
+void DrawElements(PRIMITIVES prim,
+                  Buffer2D<PIXEL>& target,
+                  const Vertex inputVerts[],
+                  const Attributes inputAttrs[],
+                  const unsigned int indices[],
+                  const int & count,
+                  Attributes* const uniforms = NULL,
+                  FragmentShader* const frag = NULL,
+                  VertexShader* const vert = NULL,
+                  DepthBuffer* zBuf = NULL);
+
+/****************************************
+ * DRAW_LINE_STRIP
+ * Connected lines through 'count' indices
+ * (or vertices when 'indices' is NULL), 
+ * see pipeline.cpp.
+ ***************************************/
+void DrawLineStrip(Buffer2D<PIXEL>& target,
+                   const Vertex inputVerts[],
+                   const Attributes inputAttrs[],
+                   const unsigned int indices[],
+                   const int & count,
+                   Attributes* const uniforms = NULL,
+                   FragmentShader* const frag = NULL,
+                   VertexShader* const vert = NULL,
+                   DepthBuffer* zBuf = NULL);
+
+/****************************************
+ * DRAW_POINT_CLOUD
+ * Point-list mode over SoA arrays 
+ * (points.h), see pipeline.cpp.
+ ***************************************/
+struct PointCloud;
+class Matrix;
+void DrawPointCloud(Buffer2D<PIXEL> & target,
+                    const PointCloud & cloud,
+                    const Matrix & mvp,
+                    DepthBuffer* zBuf = NULL,
+                    int pointSize = 1);
+
+/****************************************
+ * DRAW_PRIMITIVE_WITH / DRAW_ELEMENTS_WITH
+ * / DRAW_LINE_STRIP_WITH
+ * Templated counterparts of the above, 
+ * specialized on the shader functor types.
+ ***************************************/
+template <class FragT, class VertT>
+void DrawPrimitiveWith(PRIMITIVES prim,
+                       Buffer2D<PIXEL>& target,
+                       const Vertex inputVerts[],
+                       const Attributes inputAttrs[],
+                       Attributes* const uniforms,
+                       const FragT & frag,
+                       const VertT & vert,
+                       DepthBuffer* zBuf = NULL);
+
+template <class FragT, class VertT>
+void DrawElementsWith(PRIMITIVES prim,
+                      Buffer2D<PIXEL>& target,
+                      const Vertex inputVerts[],
+                      const Attributes inputAttrs[],
+                      const unsigned int indices[],
+                      const int & count,
+                      Attributes* const uniforms,
+                      const FragT & frag,
+                      const VertT & vert,
+                      DepthBuffer* zBuf = NULL);
+
+template <class FragT, class VertT>
+void DrawLineStripWith(Buffer2D<PIXEL>& target,
+                       const Vertex inputVerts[],
+                       const Attributes inputAttrs[],
+                       const unsigned int indices[],
+                       const int & count,
+                       Attributes* const uniforms,
+                       const FragT & frag,
+                       const VertT & vert,
+                       DepthBuffer* zBuf = NULL);
+
+/****************************************
+ * Rasterizer back end configuration, see
+ * pipeline.cpp.
+ ***************************************/
+void SetRasterThreads(int count);
+void SetTileSize(int size);
+void SetLazyClear(bool lazy);
+void ClearDepth(DepthBuffer & depth);
+void FlushPipeline();
+void FinishFrame();
+
+/****************************************
+ * Clipping stage configuration 
+ * (clipping.h), see pipeline.cpp.
+ ***************************************/
+void SetClipping(bool enabled);
+void SetGuardBand(double guardBand);
+
+/****************************************
+ * Viewport and scissor rectangles 
+ * (viewport.h), see pipeline.cpp.
+ ***************************************/
+void SetViewport(int x, int y, int width, int height);
+void SetScissor(int x, int y, int width, int height);
+void SetScissorTest(bool enabled);
+
+/****************************************
+ * Culling stage configuration (cull.h),
+ * see pipeline.cpp.
+ ***************************************/
+void SetCullMode(CULL_MODES mode);
+void SetFrontFace(WINDINGS winding);
+
+/****************************************
+ * Pipeline statistics (stats.h), see
+ * pipeline.cpp.
+ ***************************************/
+struct PipelineStats;
+void EnablePipelineStats(bool enabled);
+void ResetPipelineStats();
+PipelineStats GetPipelineStats();
        
 #endif
@@ -0,0 +1,554 @@
+#include "definitions.h"
+
+#ifndef HALFSPACE_H
+#define HALFSPACE_H
+
+// Edge length of a coverage block in pixels
+#define RASTER_BLOCK 4
+
+// Fractional bits of snapped screen coordinates
+#define SUBPIXEL_BITS 8
+#define SUBPIXEL_ONE (1 << SUBPIXEL_BITS)
+
+// Largest screen coordinate magnitude in pixels, 16.8 fixed point
+#define RASTER_COORD_LIMIT (1 << 15)
+
+/******************************************************
+ * Coverage kernels the half-space rasterizer can use.
+ *****************************************************/
+enum RASTER_KERNELS
+{
+    RASTER_SCALAR,
+    RASTER_SSE2
+};
+
+/******************************************************
+ * RASTER_VERTEX:
+ * Compact vertex handed to the rasterizer. Screen 
+ * position is snapped to SUBPIXEL_BITS of fixed point,
+ * so adjacent triangles see bit-identical shared 
+ * vertices and their edge equations are evaluated 
+ * exactly. Coordinates must lie within 
+ * +-RASTER_COORD_LIMIT pixels (InSnapRange), which 
+ * keeps edge equations inside 64 bits; primitives 
+ * reaching past it are clipped to the range in screen
+ * space before they are snapped, never clamped.
+ *****************************************************/
+struct RasterVertex
+{
+    int x;
+    int y;
+    float z;
+    float w;
+};
+
+inline bool InSnapRange(const Vertex & v)
+{
+    return ABS(v.x) < RASTER_COORD_LIMIT && ABS(v.y) < RASTER_COORD_LIMIT;
+}
+
+inline RasterVertex SnapVertex(const Vertex & v)
+{
+    RasterVertex out;
+    out.x = (int)floor(v.x * SUBPIXEL_ONE + 0.5);
+    out.y = (int)floor(v.y * SUBPIXEL_ONE + 0.5);
+    out.z = (float)v.z;
+    out.w = (float)v.w;
+    return out;
+}
+
+// Largest guard band (NDC) around the viewport at ('x', 'y') whose
+// screen coordinates still snap exactly
+inline double RasterGuardBand(const int & x, const int & y, const int & width, const int & height)
+{
+    double limit = RASTER_COORD_LIMIT - 1;
+    double band = fmin(fmin(2.0 * (limit - x) / width - 1.0, 2.0 * (limit + x) / width + 1.0),
+                       fmin(2.0 * (limit - y) / height - 1.0, 2.0 * (limit + y) / height + 1.0));
+    return band < 1.0 ? 1.0 : band;
+}
+
+/******************************************************
+ * EDGE_SETUP:
+ * Three edge equations E(x,y) = A*x + B*y + C over 
+ * subpixel coordinates, scaled so the interior is 
+ * positive. The fill rule is folded into C: edges that
+ * are not top-left lose one unit, so a sample is 
+ * inside exactly when every E >= 0. 'dx', 'dy' and 
+ * 'area' are the same edges in pixel units, for 
+ * attribute interpolation. 'wide' edges step by more
+ * than the 32-bit block kernels can carry; their 
+ * partial blocks are covered in 64 bits.
+ *****************************************************/
+struct EdgeSetup
+{
+    int A[3];
+    int B[3];
+    int64_t C[3];
+    float dx[3];
+    float dy[3];
+    float area;         // Sum of the edges anywhere, twice the area
+    bool wide;
+};
+
+/******************************************************
+ * BLOCK_COVERAGE:
+ * Result of testing one 4x4 block. Bit (r*4 + c) of 
+ * 'mask' is pixel (x + c, y + r).
+ *****************************************************/
+struct BlockCoverage
+{
+    int mask;
+};
+
+// Subpixel coordinate of the center of pixel 'p'
+inline int PixelCenter(const int & p)
+{
+    return p * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+}
+
+/******************************************************
+ * Builds edge equations for a triangle. Returns false
+ * for zero-area triangles.
+ *****************************************************/
+inline bool SetupEdges(const RasterVertex* v, EdgeSetup & s)
+{
+    int64_t C[3];
+    for(int e = 0; e < 3; e++)
+    {
+        const RasterVertex & a = v[(e + 1) % 3];
+        const RasterVertex & b = v[(e + 2) % 3];
+        s.A[e] = a.y - b.y;
+        s.B[e] = b.x - a.x;
+        C[e] = (int64_t)a.x * b.y - (int64_t)a.y * b.x;
+    }
+    int64_t area = C[0] + C[1] + C[2];
+    if(area == 0)
+    {
+        return false;
+    }
+
+    // Accept either winding
+    int sign = area > 0 ? 1 : -1;
+    const float toPixels = 1.0f / SUBPIXEL_ONE;
+    s.wide = false;
+    for(int e = 0; e < 3; e++)
+    {
+        int64_t blockStep = ((int64_t)ABS(s.A[e]) + ABS(s.B[e])) * (RASTER_BLOCK - 1) * SUBPIXEL_ONE;
+        s.wide = s.wide || blockStep >= ((int64_t)1 << 30);
+        s.A[e] *= sign;
+        s.B[e] *= sign;
+        bool topLeft = s.A[e] > 0 || (s.A[e] == 0 && s.B[e] < 0);
+        s.C[e] = C[e] * sign - (topLeft ? 0 : 1);
+        s.dx[e] = s.A[e] * toPixels;
+        s.dy[e] = s.B[e] * toPixels;
+    }
+    s.area = (float)(area * sign) * toPixels * toPixels;
+    return true;
+}
+
+// Exact edge value at subpixel position (x, y)
+inline int64_t EdgeValue(const EdgeSetup & s, const int & e, const int & x, const int & y)
+{
+    return (int64_t)s.A[e] * x + (int64_t)s.B[e] * y + s.C[e];
+}
+
+/******************************************************
+ * Whole-block tests on the four block corners. A block
+ * is rejected when some edge is negative at its most 
+ * inside corner, and accepted when every edge passes 
+ * at its least inside corner.
+ *****************************************************/
+inline bool BlockOutside(const EdgeSetup & s, const int & bx, const int & by)
+{
+    for(int e = 0; e < 3; e++)
+    {
+        int px = PixelCenter(bx + (s.A[e] > 0 ? RASTER_BLOCK - 1 : 0));
+        int py = PixelCenter(by + (s.B[e] > 0 ? RASTER_BLOCK - 1 : 0));
+        if(EdgeValue(s, e, px, py) < 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool BlockInside(const EdgeSetup & s, const int & bx, const int & by)
+{
+    for(int e = 0; e < 3; e++)
+    {
+        int px = PixelCenter(bx + (s.A[e] > 0 ? 0 : RASTER_BLOCK - 1));
+        int py = PixelCenter(by + (s.B[e] > 0 ? 0 : RASTER_BLOCK - 1));
+        if(EdgeValue(s, e, px, py) < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/******************************************************
+ * Edge values at a block's first pixel center, 
+ * narrowed to 32 bits. Values beyond +-2^30 are 
+ * saturated: for edges that are not wide no step 
+ * inside the block can change their sign, and the 
+ * kernels' adds cannot overflow.
+ *****************************************************/
+inline void BlockEdgeOrigins(const EdgeSetup & s, const int & bx, const int & by, int origin[3])
+{
+    const int64_t limit = (int64_t)1 << 30;
+    int px = PixelCenter(bx);
+    int py = PixelCenter(by);
+    for(int e = 0; e < 3; e++)
+    {
+        int64_t val = EdgeValue(s, e, px, py);
+        origin[e] = (int)(val < -limit ? -limit : (val > limit ? limit : val));
+    }
+}
+
+/******************************************************
+ * Scalar reference kernel. A pixel is inside when no
+ * edge value has its sign bit set.
+ *****************************************************/
+inline void CoverageScalar(const EdgeSetup & s, const int & bx, const int & by, BlockCoverage & out)
+{
+    int origin[3];
+    BlockEdgeOrigins(s, bx, by, origin);
+
+    out.mask = 0;
+    for(int r = 0; r < RASTER_BLOCK; r++)
+    {
+        for(int c = 0; c < RASTER_BLOCK; c++)
+        {
+            int sign = 0;
+            for(int e = 0; e < 3; e++)
+            {
+                sign |= origin[e] + (s.A[e] * c + s.B[e] * r) * SUBPIXEL_ONE;
+            }
+            out.mask |= sign >= 0 ? (1 << (r * RASTER_BLOCK + c)) : 0;
+        }
+    }
+}
+
+/******************************************************
+ * 64-bit kernel for wide edges, every pixel center
+ * evaluated exactly on its own.
+ *****************************************************/
+inline void CoverageWide(const EdgeSetup & s, const int & bx, const int & by, BlockCoverage & out)
+{
+    out.mask = 0;
+    for(int r = 0; r < RASTER_BLOCK; r++)
+    {
+        for(int c = 0; c < RASTER_BLOCK; c++)
+        {
+            int px = PixelCenter(bx + c);
+            int py = PixelCenter(by + r);
+            bool inside = EdgeValue(s, 0, px, py) >= 0 && EdgeValue(s, 1, px, py) >= 0 && EdgeValue(s, 2, px, py) >= 0;
+            out.mask |= inside ? (1 << (r * RASTER_BLOCK + c)) : 0;
+        }
+    }
+}
+
+#ifdef HAS_SSE2
+/******************************************************
+ * SSE2 kernel, one block row of four pixels per 
+ * vector, stepping rows with integer adds only. Both
+ * kernels compute exact values, so their masks match.
+ *****************************************************/
+inline void CoverageSSE2(const EdgeSetup & s, const int & bx, const int & by, BlockCoverage & out)
+{
+    int origin[3];
+    BlockEdgeOrigins(s, bx, by, origin);
+
+    __m128i val[3];
+    __m128i stepY[3];
+    for(int e = 0; e < 3; e++)
+    {
+        int stepX = s.A[e] * SUBPIXEL_ONE;
+        val[e] = _mm_add_epi32(_mm_set1_epi32(origin[e]), _mm_setr_epi32(0, stepX, stepX * 2, stepX * 3));
+        stepY[e] = _mm_set1_epi32(s.B[e] * SUBPIXEL_ONE);
+    }
+
+    out.mask = 0;
+    for(int r = 0; r < RASTER_BLOCK; r++)
+    {
+        __m128i sign = _mm_or_si128(_mm_or_si128(val[0], val[1]), val[2]);
+        int outside = _mm_movemask_ps(_mm_castsi128_ps(sign));
+        out.mask |= (~outside & ((1 << RASTER_BLOCK) - 1)) << (r * RASTER_BLOCK);
+        for(int e = 0; e < 3; e++)
+        {
+            val[e] = _mm_add_epi32(val[e], stepY[e]);
+        }
+    }
+}
+#endif
+
+/******************************************************
+ * VARYING_SETUP:
+ * Screen-space plane equations for the interpolated w
+ * and every attribute slot, anchored at vertex 0. Slot
+ * planes are stored SoA so a whole Attributes block 
+ * steps with a few vector adds.
+ *****************************************************/
+struct VaryingSetup
+{
+    alignas(16) float base[MAX_ATTRIBUTES];
+    alignas(16) float dx[MAX_ATTRIBUTES];
+    alignas(16) float dy[MAX_ATTRIBUTES];
+    float wBase;
+    float wdx;
+    float wdy;
+    double originX;
+    double originY;
+};
+
+inline void SetupVaryings(const RasterVertex* v, const Attributes* a, const EdgeSetup & s, VaryingSetup & out)
+{
+    // d/dx of sum(value_i * E_i) / area is sum(value_i * A_i) / area
+    float invArea = 1.0f / s.area;
+    for(int k = 0; k < MAX_ATTRIBUTES; k++)
+    {
+        out.base[k] = a[0].value[k];
+        out.dx[k] = (a[0].value[k] * s.dx[0] + a[1].value[k] * s.dx[1] + a[2].value[k] * s.dx[2]) * invArea;
+        out.dy[k] = (a[0].value[k] * s.dy[0] + a[1].value[k] * s.dy[1] + a[2].value[k] * s.dy[2]) * invArea;
+    }
+    out.wBase = v[0].w;
+    out.wdx = (v[0].w * s.dx[0] + v[1].w * s.dx[1] + v[2].w * s.dx[2]) * invArea;
+    out.wdy = (v[0].w * s.dy[0] + v[1].w * s.dy[1] + v[2].w * s.dy[2]) * invArea;
+    out.originX = (double)v[0].x / SUBPIXEL_ONE;
+    out.originY = (double)v[0].y / SUBPIXEL_ONE;
+}
+
+/******************************************************
+ * Slot-wise helpers over a full Attributes block.
+ *****************************************************/
+// out = a + b * scale
+inline void VaryingMulAdd(float* out, const float* a, const float* b, const float & scale)
+{
+#ifdef HAS_SSE2
+    __m128 s = _mm_set1_ps(scale);
+    for(int k = 0; k < MAX_ATTRIBUTES; k += 4)
+    {
+        _mm_store_ps(out + k, _mm_add_ps(_mm_load_ps(a + k), _mm_mul_ps(_mm_load_ps(b + k), s)));
+    }
+#else
+    for(int k = 0; k < MAX_ATTRIBUTES; k++)
+    {
+        out[k] = a[k] + b[k] * scale;
+    }
+#endif
+}
+
+// acc += step
+inline void VaryingStep(float* acc, const float* step)
+{
+#ifdef HAS_SSE2
+    for(int k = 0; k < MAX_ATTRIBUTES; k += 4)
+    {
+        _mm_store_ps(acc + k, _mm_add_ps(_mm_load_ps(acc + k), _mm_load_ps(step + k)));
+    }
+#else
+    for(int k = 0; k < MAX_ATTRIBUTES; k++)
+    {
+        acc[k] += step[k];
+    }
+#endif
+}
+
+// out = in * scale
+inline void VaryingScale(float* out, const float* in, const float & scale)
+{
+#ifdef HAS_SSE2
+    __m128 s = _mm_set1_ps(scale);
+    for(int k = 0; k < MAX_ATTRIBUTES; k += 4)
+    {
+        _mm_store_ps(out + k, _mm_mul_ps(_mm_load_ps(in + k), s));
+    }
+#else
+    for(int k = 0; k < MAX_ATTRIBUTES; k++)
+    {
+        out[k] = in[k] * scale;
+    }
+#endif
+}
+
+/******************************************************
+ * Lanes of the 2x2 quad at column 'qc', row 'qr' of a
+ * block coverage mask, in FragmentQuad lane order.
+ *****************************************************/
+inline int QuadMask(const int & mask, const int & qc, const int & qr)
+{
+    int low = (mask >> (qr * RASTER_BLOCK + qc)) & 3;
+    int high = (mask >> ((qr + 1) * RASTER_BLOCK + qc)) & 3;
+    return low | (high << 2);
+}
+
+/******************************************************
+ * Interpolates the four lanes of a quad whose first
+ * lane has plane values 'planeVals' and w 'w', then
+ * divides each lane by its own w.
+ *****************************************************/
+inline void InterpolateQuad(const VaryingSetup & vary, const float* planeVals, const float & w, FragmentQuad & quad)
+{
+    alignas(16) float invW[QUAD_LANES];
+#ifdef HAS_SSE2
+    __m128 lanesW = _mm_add_ps(_mm_set1_ps(w), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(vary.wdx), _mm_setr_ps(0, 1, 0, 1)),
+                                                         _mm_mul_ps(_mm_set1_ps(vary.wdy), _mm_setr_ps(0, 0, 1, 1))));
+    _mm_store_ps(invW, _mm_div_ps(_mm_set1_ps(1.0f), lanesW));
+    for(int k = 0; k < MAX_ATTRIBUTES; k += 4)
+    {
+        __m128 p0 = _mm_load_ps(planeVals + k);
+        __m128 px = _mm_load_ps(vary.dx + k);
+        __m128 py = _mm_load_ps(vary.dy + k);
+        __m128 p1 = _mm_add_ps(p0, px);
+        _mm_store_ps(quad.frag[0].value + k, _mm_mul_ps(p0, _mm_set1_ps(invW[0])));
+        _mm_store_ps(quad.frag[1].value + k, _mm_mul_ps(p1, _mm_set1_ps(invW[1])));
+        _mm_store_ps(quad.frag[2].value + k, _mm_mul_ps(_mm_add_ps(p0, py), _mm_set1_ps(invW[2])));
+        _mm_store_ps(quad.frag[3].value + k, _mm_mul_ps(_mm_add_ps(p1, py), _mm_set1_ps(invW[3])));
+    }
+#else
+    for(int lane = 0; lane < QUAD_LANES; lane++)
+    {
+        invW[lane] = 1.0f / (w + vary.wdx * (lane & 1) + vary.wdy * (lane >> 1));
+    }
+    for(int k = 0; k < MAX_ATTRIBUTES; k++)
+    {
+        float p0 = planeVals[k];
+        float p1 = p0 + vary.dx[k];
+        quad.frag[0].value[k] = p0 * invW[0];
+        quad.frag[1].value[k] = p1 * invW[1];
+        quad.frag[2].value[k] = (p0 + vary.dy[k]) * invW[2];
+        quad.frag[3].value[k] = (p1 + vary.dy[k]) * invW[3];
+    }
+#endif
+}
+
+/******************************************************
+ * Quad derivatives of every slot, differenced along 
+ * the quad's first row and column once its lanes are
+ * interpolated.
+ *****************************************************/
+inline void QuadGradients(FragmentQuad & quad)
+{
+    const float* base = quad.frag[0].value;
+    const float* right = quad.frag[1].value;
+    const float* up = quad.frag[2].value;
+#ifdef HAS_SSE2
+    for(int k = 0; k < MAX_ATTRIBUTES; k += 4)
+    {
+        __m128 b = _mm_load_ps(base + k);
+        _mm_store_ps(quad.grad.ddx + k, _mm_sub_ps(_mm_load_ps(right + k), b));
+        _mm_store_ps(quad.grad.ddy + k, _mm_sub_ps(_mm_load_ps(up + k), b));
+    }
+#else
+    for(int k = 0; k < MAX_ATTRIBUTES; k++)
+    {
+        quad.grad.ddx[k] = right[k] - base[k];
+        quad.grad.ddy[k] = up[k] - base[k];
+    }
+#endif
+}
+
+/******************************************************
+ * EARLY_DEPTH_TEST:
+ * Depth tests one block row of four pixels before any
+ * shading. 'w' is the interpolated 1/w of the row's 
+ * first pixel, stepping by 'wdx'. Passing lanes store 
+ * their depth; returns the surviving lanes of 
+ * 'rowMask'. 'zRow' must be 16-byte aligned.
+ *****************************************************/
+inline int EarlyDepthTest(float* zRow, const float & w, const float & wdx, const int & rowMask)
+{
+#ifdef HAS_SSE2
+    __m128 depth = _mm_add_ps(_mm_set1_ps(w), _mm_mul_ps(_mm_set1_ps(wdx), _mm_setr_ps(0, 1, 2, 3)));
+    __m128 stored = _mm_load_ps(zRow);
+    __m128 pass = _mm_cmpgt_ps(depth, stored);
+    int passMask = _mm_movemask_ps(pass) & rowMask;
+    __m128 lanes = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_and_si128(_mm_set1_epi32(passMask), _mm_setr_epi32(1, 2, 4, 8)), _mm_setzero_si128()));
+    _mm_store_ps(zRow, _mm_or_ps(_mm_and_ps(lanes, depth), _mm_andnot_ps(lanes, stored)));
+    return passMask;
+#else
+    int passMask = 0;
+    for(int c = 0; c < RASTER_BLOCK; c++)
+    {
+        float depth = w + wdx * c;
+        if(((rowMask >> c) & 1) && depth > zRow[c])
+        {
+            zRow[c] = depth;
+            passMask |= 1 << c;
+        }
+    }
+    return passMask;
+#endif
+}
+
+/******************************************************
+ * DEPTH_WRITE_ROW:
+ * Stores the depth of the 'rowMask' lanes of one block
+ * row without comparing, for blocks the coarse bounds
+ * already prove to be in front. Same depth values and
+ * alignment as EarlyDepthTest.
+ *****************************************************/
+inline void DepthWriteRow(float* zRow, const float & w, const float & wdx, const int & rowMask)
+{
+#ifdef HAS_SSE2
+    __m128 depth = _mm_add_ps(_mm_set1_ps(w), _mm_mul_ps(_mm_set1_ps(wdx), _mm_setr_ps(0, 1, 2, 3)));
+    __m128 stored = _mm_load_ps(zRow);
+    __m128 lanes = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_and_si128(_mm_set1_epi32(rowMask), _mm_setr_epi32(1, 2, 4, 8)), _mm_setzero_si128()));
+    _mm_store_ps(zRow, _mm_or_ps(_mm_and_ps(lanes, depth), _mm_andnot_ps(lanes, stored)));
+#else
+    for(int c = 0; c < RASTER_BLOCK; c++)
+    {
+        if((rowMask >> c) & 1)
+        {
+            zRow[c] = w + wdx * c;
+        }
+    }
+#endif
+}
+
+/******************************************************
+ * Kernel selection. Defaults to the widest kernel the
+ * build supports; can be overridden at start up (for
+ * benchmarks and debugging).
+ *****************************************************/
+inline RASTER_KERNELS & ActiveRasterKernel()
+{
+#ifdef HAS_SSE2
+    static RASTER_KERNELS kernel = RASTER_SSE2;
+#else
+    static RASTER_KERNELS kernel = RASTER_SCALAR;
+#endif
+    return kernel;
+}
+
+// Returns false if the requested kernel is not compiled in
+inline bool SetRasterKernel(RASTER_KERNELS kernel)
+{
+#ifndef HAS_SSE2
+    if(kernel == RASTER_SSE2)
+    {
+        return false;
+    }
+#endif
+    ActiveRasterKernel() = kernel;
+    return true;
+}
+
+inline void BlockCoverageOf(const EdgeSetup & s, const int & bx, const int & by, BlockCoverage & out)
+{
+    if(s.wide)
+    {
+        CoverageWide(s, bx, by, out);
+        return;
+    }
+#ifdef HAS_SSE2
+    if(ActiveRasterKernel() == RASTER_SSE2)
+    {
+        CoverageSSE2(s, bx, by, out);
+        return;
+    }
+#endif
+    CoverageScalar(s, bx, by, out);
+}
+
+#endif
@@ -0,0 +1,509 @@
+/*************************************************************
+ * HEADLESS:
+ * Offscreen renderer and frame benchmark. Renders one of the
+ * test scenes into a plain Buffer2D with no window or SDL 
+ * video for a number of frames, then reports frames per 
+ * second and the median and 99th percentile frame time.
+ *
+ * Build:  g++ -O2 -std=c++11 headless.cpp -lSDL2 -pthread
+ * Usage:  ./a.out <scene> [frames] [--threads N] [--tile N]
+ *                 [--out last_frame.bmp] [--stats]
+ * Scenes: pixel, triangle, fragments, perspective, 
+ *         vertexshader, pipeline, elements, replay, cad
+ *
+ * Life:   ./a.out life [generations] [--size N] [--threads N]
+ *                 [--bounded] [--out state.bmp]
+ *         Game of Life throughput on an N x N random grid, in
+ *         generations and cells per second.
+ *
+ * Points: ./a.out points [frames] [--count N] [--size N] 
+ *                 [--threads N] [--out last_frame.bmp]
+ *         Point-cloud throughput: N random points (10M by 
+ *         default) as N x N sprites, depth tested, in frames
+ *         and points per second.
+ *
+ * OBJ:    ./a.out obj <file.obj> [frames] [--threads N]
+ *                 [--no-reorder] [--out last_frame.bmp]
+ *         Mesh load time and size, vertex cache efficiency,
+ *         then render throughput of the model, depth tested.
+ ************************************************************/
+#define PIPELINE_NO_MAIN
+#include "pipeline.cpp"
+#include "bmpio.h"
+#include "scenes.h"
+#include "objloader.h"
+#include <chrono>
+#include <algorithm>
+#include <string>
+
+/*************************************************************
+ * Scene table.
+ ************************************************************/
+struct HeadlessScene
+{
+    const char* name;
+    void (*draw)(Buffer2D<PIXEL> & target);
+};
+
+static const HeadlessScene SCENES[] = 
+{
+    { "pixel",        ScenePixel },
+    { "triangle",     SceneTriangle },
+    { "fragments",    SceneFragments },
+    { "perspective",  ScenePerspective },
+    { "vertexshader", SceneVertexShader },
+    { "pipeline",     ScenePipeline },
+    { "elements",     SceneElements },
+    { "replay",       SceneReplay },
+    { "cad",          CADView }
+};
+static const int NUM_SCENES = sizeof(SCENES) / sizeof(SCENES[0]);
+
+void PrintUsage()
+{
+    printf("usage: headless <scene> [frames] [--threads N] [--tile N] [--out file.bmp] [--stats]\n");
+    printf("       headless life [generations] [--size N] [--threads N] [--bounded] [--out file.bmp]\n");
+    printf("       headless points [frames] [--count N] [--size N] [--threads N] [--out file.bmp]\n");
+    printf("       headless obj <file.obj> [frames] [--threads N] [--no-reorder] [--out file.bmp]\n");
+    printf("scenes:");
+    for(int i = 0; i < NUM_SCENES; i++)
+    {
+        printf(" %s", SCENES[i].name);
+    }
+    printf("\n");
+}
+
+/*************************************************************
+ * Value at fraction 'q' of an ascending sample list.
+ ************************************************************/
+double Percentile(const std::vector<double> & sorted, const double & q)
+{
+    size_t idx = (size_t)ceil(q * sorted.size());
+    idx = idx == 0 ? 0 : idx - 1;
+    return sorted[idx < sorted.size() ? idx : sorted.size() - 1];
+}
+
+/*************************************************************
+ * Game of Life benchmark, arguments after "life".
+ ************************************************************/
+int RunLifeBenchmark(int argc, char** argv)
+{
+    int generations = 1000;
+    int size = 4096;
+    int threads = std::thread::hardware_concurrency();
+    LIFE_EDGES edges = LIFE_TOROIDAL;
+    const char* outPath = NULL;
+
+    for(int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--size" && i + 1 < argc)
+        {
+            size = atoi(argv[++i]);
+        }
+        else if(arg == "--threads" && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if(arg == "--bounded")
+        {
+            edges = LIFE_BOUNDED;
+        }
+        else if(arg == "--out" && i + 1 < argc)
+        {
+            outPath = argv[++i];
+        }
+        else
+        {
+            generations = atoi(argv[i]);
+        }
+    }
+    if(generations <= 0 || size <= 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    WorkerPool pool(threads < 1 ? 1 : threads);
+    LifeGrid grid(size, size, edges);
+    grid.randomize(1, 0.3);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int g = 0; g < generations; g++)
+    {
+        grid.step(pool);
+    }
+    std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+
+    double cells = (double)size * size;
+    printf("life:    %d x %d, %s (%d threads)\n", size, size, edges == LIFE_TOROIDAL ? "toroidal" : "bounded", pool.size());
+    printf("gens:    %d\n", generations);
+    printf("gen/s:   %.1f\n", generations / total.count());
+    printf("cells/s: %.3g\n", cells * generations / total.count());
+    printf("alive:   %llu\n", (unsigned long long)grid.population());
+
+    if(outPath != NULL)
+    {
+        Buffer2D<PIXEL> frame(S_WIDTH, S_HEIGHT);
+        grid.draw(frame, 0, 0, 1);
+        if(!SaveBMP(frame, outPath))
+        {
+            printf("could not write %s\n", outPath);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*************************************************************
+ * Point-cloud benchmark, arguments after "points".
+ ************************************************************/
+int RunPointsBenchmark(int argc, char** argv)
+{
+    int frames = 20;
+    int count = 10000000;
+    int size = 1;
+    int threads = std::thread::hardware_concurrency();
+    const char* outPath = NULL;
+
+    for(int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--count" && i + 1 < argc)
+        {
+            count = atoi(argv[++i]);
+        }
+        else if(arg == "--size" && i + 1 < argc)
+        {
+            size = atoi(argv[++i]);
+        }
+        else if(arg == "--threads" && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if(arg == "--out" && i + 1 < argc)
+        {
+            outPath = argv[++i];
+        }
+        else
+        {
+            frames = atoi(argv[i]);
+        }
+    }
+    if(frames <= 0 || count <= 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // A fixed blob of points, denser toward its center
+    std::vector<float> x(count);
+    std::vector<float> y(count);
+    std::vector<float> z(count);
+    std::vector<PIXEL> color(count);
+    srand(1);
+    for(int i = 0; i < count; i++)
+    {
+        float r = (float)rand() / RAND_MAX;
+        float u = 2.0f * rand() / RAND_MAX - 1.0f;
+        float a = 6.2831853f * rand() / RAND_MAX;
+        float s = sqrtf(1.0f - u * u);
+        x[i] = r * s * cosf(a);
+        y[i] = r * u;
+        z[i] = r * s * sinf(a);
+        color[i] = 0xff000000 | ((int)(255 * r) << 16) | ((int)(255 * (1 - r)) << 8) | 0x80;
+    }
+    PointCloud cloud = {&x[0], &y[0], &z[0], &color[0], 0, count};
+
+    SetRasterThreads(threads);
+    SetLazyClear(true);
+    Buffer2D<PIXEL> frame(S_WIDTH, S_HEIGHT);
+    DepthBuffer depth(S_WIDTH, S_HEIGHT);
+    Matrix proj = Matrix::perspective(1.0, (double)S_WIDTH / S_HEIGHT, 0.1, 100);
+
+    std::vector<double> times;
+    for(int f = 0; f < frames; f++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        clearScreen(frame);
+        ClearDepth(depth);
+        Matrix mvp = proj * Matrix::translate(0, 0, -2.5) * Matrix::rotateY(0.05 * f);
+        DrawPointCloud(frame, cloud, mvp, &depth, size);
+        FinishFrame();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::vector<double> sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for(size_t i = 0; i < times.size(); i++)
+    {
+        total += times[i];
+    }
+    printf("points:  %d as %d x %d sprites (%d threads)\n", count, size, size, GetTileRenderer().threads());
+    printf("frames:  %d\n", frames);
+    printf("fps:     %.1f\n", 1000.0 * frames / total);
+    printf("median:  %.3f ms\n", Percentile(sorted, 0.5));
+    printf("pts/s:   %.3g\n", (double)count * frames * 1000.0 / total);
+
+    if(outPath != NULL && !SaveBMP(frame, outPath))
+    {
+        printf("could not write %s\n", outPath);
+        return 1;
+    }
+    return 0;
+}
+
+/*************************************************************
+ * OBJ mesh benchmark, arguments after "obj". The model is
+ * centered and scaled to fit, shaded by its normals when it
+ * has them.
+ ************************************************************/
+struct NormalFragShader
+{
+    bool hasNormals;
+    int normalSlot;
+
+    inline void operator()(PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms) const
+    {
+        float shade = hasNormals ? 0.2f + 0.8f * ABS(vertAttr[normalSlot + 2]) : 0.8f;
+        int c = (int)(255 * shade);
+        fragment = 0xff000000 | (c << 16) | (c << 8) | c;
+    }
+};
+
+int RunObjBenchmark(int argc, char** argv)
+{
+    const char* path = NULL;
+    int frames = 20;
+    int threads = std::thread::hardware_concurrency();
+    bool reorder = true;
+    const char* outPath = NULL;
+
+    for(int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--threads" && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if(arg == "--no-reorder")
+        {
+            reorder = false;
+        }
+        else if(arg == "--out" && i + 1 < argc)
+        {
+            outPath = argv[++i];
+        }
+        else if(path == NULL)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            frames = atoi(argv[i]);
+        }
+    }
+    if(path == NULL || frames <= 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    SetRasterThreads(threads);
+    SetLazyClear(true);
+    ObjMesh mesh;
+    std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+    if(!LoadOBJ(path, mesh, GetTileRenderer().workers(), reorder))
+    {
+        printf("could not load %s\n", path);
+        return 1;
+    }
+    std::chrono::duration<double, std::milli> loadMs = std::chrono::steady_clock::now() - loadStart;
+
+    int numVerts = (int)mesh.verts.size();
+    int count = (int)mesh.indices.size();
+    double bytes = (double)numVerts * (sizeof(Vertex) + sizeof(Attributes)) + (double)count * sizeof(unsigned int);
+    printf("mesh:    %s (%d threads)\n", path, GetTileRenderer().threads());
+    printf("load:    %.1f ms\n", loadMs.count());
+    printf("tris:    %d\n", count / 3);
+    printf("verts:   %d (%.2f per triangle)\n", numVerts, count > 0 ? 3.0 * numVerts / count : 0.0);
+    printf("memory:  %.1f MB\n", bytes / (1024 * 1024));
+    printf("acmr:    %.3f (%d-entry FIFO)\n", CacheMissRatio(mesh.indices.data(), count, numVerts), VERTEX_CACHE_SIZE);
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    double lo[3] = {1e30, 1e30, 1e30};
+    double hi[3] = {-1e30, -1e30, -1e30};
+    for(int i = 0; i < numVerts; i++)
+    {
+        double p[3] = {mesh.verts[i].x, mesh.verts[i].y, mesh.verts[i].z};
+        for(int k = 0; k < 3; k++)
+        {
+            lo[k] = p[k] < lo[k] ? p[k] : lo[k];
+            hi[k] = p[k] > hi[k] ? p[k] : hi[k];
+        }
+    }
+    double extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+    double fit = extent > 0 ? 2.0 / extent : 1.0;
+
+    Buffer2D<PIXEL> frame(S_WIDTH, S_HEIGHT);
+    DepthBuffer depth(S_WIDTH, S_HEIGHT);
+    Matrix proj = Matrix::perspective(1.0, (double)S_WIDTH / S_HEIGHT, 0.1, 100);
+    NormalFragShader frag = { mesh.hasNormals, mesh.hasTexCoords ? 2 : 0 };
+
+    std::vector<double> times;
+    for(int f = 0; f < frames; f++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        clearScreen(frame);
+        ClearDepth(depth);
+        Matrix mvp = proj * Matrix::translate(0, 0, -2.5) * Matrix::rotateY(0.05 * f) * Matrix::scale(fit, fit, fit) *
+                     Matrix::translate(-(lo[0] + hi[0]) / 2, -(lo[1] + hi[1]) / 2, -(lo[2] + hi[2]) / 2);
+        DrawElementsWith(TRIANGLE, frame, mesh.verts.data(), mesh.attrs.data(), mesh.indices.data(), count,
+                         (Attributes*)NULL, frag, MatrixVertShader(&mvp), &depth);
+        FinishFrame();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::sort(times.begin(), times.end());
+    printf("frames:  %d\n", frames);
+    printf("median:  %.3f ms\n", Percentile(times, 0.5));
+    printf("tris/s:  %.3g\n", count / 3 * 1000.0 / Percentile(times, 0.5));
+
+    if(outPath != NULL && !SaveBMP(frame, outPath))
+    {
+        printf("could not write %s\n", outPath);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc > 1 && std::string(argv[1]) == "life")
+    {
+        return RunLifeBenchmark(argc, argv);
+    }
+    if(argc > 1 && std::string(argv[1]) == "points")
+    {
+        return RunPointsBenchmark(argc, argv);
+    }
+    if(argc > 1 && std::string(argv[1]) == "obj")
+    {
+        return RunObjBenchmark(argc, argv);
+    }
+
+    const HeadlessScene* scene = NULL;
+    int frames = 500;
+    int threads = std::thread::hardware_concurrency();
+    int tileSize = 64;
+    const char* outPath = NULL;
+    bool stats = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--threads" && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if(arg == "--tile" && i + 1 < argc)
+        {
+            tileSize = atoi(argv[++i]);
+        }
+        else if(arg == "--out" && i + 1 < argc)
+        {
+            outPath = argv[++i];
+        }
+        else if(arg == "--stats")
+        {
+            stats = true;
+        }
+        else if(scene == NULL)
+        {
+            for(int s = 0; s < NUM_SCENES; s++)
+            {
+                if(arg == SCENES[s].name)
+                {
+                    scene = &SCENES[s];
+                }
+            }
+            if(scene == NULL)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else
+        {
+            frames = atoi(argv[i]);
+        }
+    }
+    if(scene == NULL || frames <= 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    Buffer2D<PIXEL> frame(S_WIDTH, S_HEIGHT);
+    SetRasterThreads(threads);
+    SetTileSize(tileSize);
+    SetLazyClear(true);
+    EnablePipelineStats(stats);
+    ResetPipelineStats();
+
+    std::vector<double> frameMs;
+    frameMs.reserve(frames);
+    std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+    for(int f = 0; f < frames; f++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        clearScreen(frame);
+        scene->draw(frame);
+        FinishFrame();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        frameMs.push_back(elapsed.count());
+    }
+    std::chrono::duration<double> total = std::chrono::steady_clock::now() - runStart;
+
+    std::sort(frameMs.begin(), frameMs.end());
+    printf("scene:   %s\n", scene->name);
+    printf("frames:  %d (%d threads, %d px tiles)\n", frames, threads < 1 ? 1 : threads, tileSize);
+    printf("fps:     %.1f\n", frames / total.count());
+    printf("p50:     %.3f ms\n", Percentile(frameMs, 0.50));
+    printf("p99:     %.3f ms\n", Percentile(frameMs, 0.99));
+
+    if(stats)
+    {
+        static const char* stageNames[NUM_STAGES] = { "vertex", "clip", "normalize", "viewport", "cull", "bin", "raster" };
+        PipelineStats totals = GetPipelineStats();
+        printf("per frame:\n");
+        printf("  vertices shaded        %12.1f\n", (double)totals.verticesShaded / frames);
+        printf("  primitives submitted   %12.1f\n", (double)totals.primitivesSubmitted / frames);
+        printf("  primitives clipped     %12.1f\n", (double)totals.primitivesClipped / frames);
+        printf("  primitives culled      %12.1f\n", (double)totals.primitivesCulled / frames);
+        static const char* cullNames[NUM_CULL_REASONS] = { "degenerate", "backface", "outside", "no samples" };
+        for(int r = 0; r < NUM_CULL_REASONS; r++)
+        {
+            printf("    %-20s %12.1f\n", cullNames[r], (double)totals.primitivesCulledBy[r] / frames);
+        }
+        printf("  primitives rasterized  %12.1f\n", (double)totals.primitivesRasterized / frames);
+        printf("  fragments generated    %12.1f\n", (double)totals.fragmentsGenerated / frames);
+        printf("  fragments depth-failed %12.1f\n", (double)totals.fragmentsDepthRejected / frames);
+        printf("  fragments shaded       %12.1f\n", (double)totals.fragmentsShaded / frames);
+        for(int s = 0; s < NUM_STAGES; s++)
+        {
+            printf("  %-10s stage time  %12.3f us\n", stageNames[s], totals.stageNs[s] / 1000.0 / frames);
+        }
+    }
+
+    if(outPath != NULL && !SaveBMP(frame, outPath))
+    {
+        printf("could not write %s\n", outPath);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,384 @@
+#include "definitions.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <bitset>
+
+#ifndef LIFE_H
+#define LIFE_H
+
+// Cells packed per storage word
+#define LIFE_WORD_BITS 64
+
+// Row bands handed out per thread per generation, for load balance
+#define LIFE_BANDS_PER_THREAD 4
+
+/******************************************************
+ * How the grid treats cells past its edges.
+ *****************************************************/
+enum LIFE_EDGES
+{
+    LIFE_TOROIDAL,      // Opposite edges are neighbors
+    LIFE_BOUNDED        // Everything outside is dead
+};
+
+/******************************************************
+ * Next state of 64 (or 128) cells from their three
+ * rows of neighbors, with bit-sliced adders: every bit
+ * position is an independent cell, so one pass of
+ * logic ops counts the neighbors of the whole word.
+ * Rows above and below contribute left, center and
+ * right words, the cell's own row only left and right.
+ * A cell lives with exactly 3 neighbors, or with 2 if
+ * it is alive.
+ *****************************************************/
+inline uint64_t LifeRule(const uint64_t & upL, const uint64_t & up, const uint64_t & upR,
+                         const uint64_t & midL, const uint64_t & cell, const uint64_t & midR,
+                         const uint64_t & dnL, const uint64_t & dn, const uint64_t & dnR)
+{
+    // Per-row sums as (twos, ones) pairs
+    uint64_t onesUp = upL ^ up ^ upR;
+    uint64_t twosUp = (upL & up) | (upR & (upL ^ up));
+    uint64_t onesDn = dnL ^ dn ^ dnR;
+    uint64_t twosDn = (dnL & dn) | (dnR & (dnL ^ dn));
+    uint64_t onesMid = midL ^ midR;
+    uint64_t twosMid = midL & midR;
+
+    // Add the ones, carrying into a fourth twos bit
+    uint64_t ones = onesUp ^ onesDn ^ onesMid;
+    uint64_t twosCarry = (onesUp & onesDn) | (onesMid & (onesUp ^ onesDn));
+
+    // Total is 2 or 3 exactly when one twos bit is set
+    uint64_t twosOdd = twosUp ^ twosDn ^ twosMid ^ twosCarry;
+    uint64_t twosMany = (twosUp & twosDn) | (twosMid & twosCarry) | ((twosUp | twosDn) & (twosMid | twosCarry));
+    return twosOdd & ~twosMany & (ones | cell);
+}
+
+#ifdef HAS_SSE2
+inline __m128i LifeRule(const __m128i & upL, const __m128i & up, const __m128i & upR,
+                        const __m128i & midL, const __m128i & cell, const __m128i & midR,
+                        const __m128i & dnL, const __m128i & dn, const __m128i & dnR)
+{
+    __m128i onesUp = _mm_xor_si128(_mm_xor_si128(upL, up), upR);
+    __m128i twosUp = _mm_or_si128(_mm_and_si128(upL, up), _mm_and_si128(upR, _mm_xor_si128(upL, up)));
+    __m128i onesDn = _mm_xor_si128(_mm_xor_si128(dnL, dn), dnR);
+    __m128i twosDn = _mm_or_si128(_mm_and_si128(dnL, dn), _mm_and_si128(dnR, _mm_xor_si128(dnL, dn)));
+    __m128i onesMid = _mm_xor_si128(midL, midR);
+    __m128i twosMid = _mm_and_si128(midL, midR);
+
+    __m128i ones = _mm_xor_si128(_mm_xor_si128(onesUp, onesDn), onesMid);
+    __m128i twosCarry = _mm_or_si128(_mm_and_si128(onesUp, onesDn), _mm_and_si128(onesMid, _mm_xor_si128(onesUp, onesDn)));
+
+    __m128i twosOdd = _mm_xor_si128(_mm_xor_si128(twosUp, twosDn), _mm_xor_si128(twosMid, twosCarry));
+    __m128i twosMany = _mm_or_si128(_mm_or_si128(_mm_and_si128(twosUp, twosDn), _mm_and_si128(twosMid, twosCarry)),
+                                    _mm_and_si128(_mm_or_si128(twosUp, twosDn), _mm_or_si128(twosMid, twosCarry)));
+    return _mm_and_si128(_mm_andnot_si128(twosMany, twosOdd), _mm_or_si128(ones, cell));
+}
+#endif
+
+/******************************************************
+ * LIFE_GRID:
+ * Conway's Game of Life on a bitboard of any size, bit
+ * (x % 64) of word (x / 64) in row y. Rows carry one
+ * pad word on each side and the grid one pad row above
+ * and below; before every generation the pads are
+ * filled with the wrapped-around cells (toroidal) or
+ * left dead (bounded), so the inner loop never tests
+ * for edges. Generations run in row bands across a
+ * WorkerPool and give the same result on any number
+ * of threads.
+ *
+ * The grid knows nothing about the display; 'draw'
+ * only reads the current state.
+ *****************************************************/
+class LifeGrid
+{
+    private:
+        int w;
+        int h;
+        int words;          // Storage words per row, pads excluded
+        int stride;         // Distance between rows, pads included
+        uint64_t lastMask;  // Valid bits of each row's last word
+        LIFE_EDGES edges;
+        uint64_t* cells;
+        uint64_t* next;
+        uint64_t generation;
+
+        // Row 'y' of 'grid', -1 and h are the pad rows
+        uint64_t* row(uint64_t* grid, const int & y) const
+        {
+            return grid + (size_t)(y + 1) * stride + 1;
+        }
+
+        const uint64_t* row(const int & y) const
+        {
+            return cells + (size_t)(y + 1) * stride + 1;
+        }
+
+        // Fill the pad words and rows of the current grid
+        void fillPads()
+        {
+            int tail = w % LIFE_WORD_BITS;
+            for(int y = 0; y < h; y++)
+            {
+                uint64_t* r = row(cells, y);
+                r[words - 1] &= lastMask;
+                if(edges == LIFE_BOUNDED)
+                {
+                    r[-1] = 0;
+                    r[words] = 0;
+                    continue;
+                }
+
+                // Cell w - 1 is left of cell 0, cell 0 right of cell w - 1
+                r[-1] = ((r[(w - 1) / LIFE_WORD_BITS] >> ((w - 1) % LIFE_WORD_BITS)) & 1) << (LIFE_WORD_BITS - 1);
+                if(tail == 0)
+                {
+                    r[words] = r[0] & 1;
+                }
+                else
+                {
+                    r[words - 1] |= (r[0] & 1) << tail;
+                    r[words] = 0;
+                }
+            }
+
+            size_t rowBytes = sizeof(uint64_t) * stride;
+            if(edges == LIFE_TOROIDAL)
+            {
+                memcpy(row(cells, -1) - 1, row(cells, h - 1) - 1, rowBytes);
+                memcpy(row(cells, h) - 1, row(cells, 0) - 1, rowBytes);
+            }
+            else
+            {
+                memset(row(cells, -1) - 1, 0, rowBytes);
+                memset(row(cells, h) - 1, 0, rowBytes);
+            }
+        }
+
+        // Advance rows [y0, y1) from 'cells' into 'next'
+        void stepRows(const int & y0, const int & y1)
+        {
+            for(int y = y0; y < y1; y++)
+            {
+                const uint64_t* up = row(cells, y + 1);
+                const uint64_t* mid = row(cells, y);
+                const uint64_t* dn = row(cells, y - 1);
+                uint64_t* out = row(next, y);
+
+                int i = 0;
+#ifdef HAS_SSE2
+                // Two words per vector; the neighbor words are the same
+                // loads shifted by one, and the pads cover both ends
+                for(; i < words; i += 2)
+                {
+                    __m128i vUp[3];
+                    __m128i vMid[3];
+                    __m128i vDn[3];
+                    const uint64_t* src[3] = { up, mid, dn };
+                    __m128i* dst[3] = { vUp, vMid, vDn };
+                    for(int k = 0; k < 3; k++)
+                    {
+                        __m128i prev = _mm_loadu_si128((const __m128i*)(src[k] + i - 1));
+                        __m128i cur = _mm_loadu_si128((const __m128i*)(src[k] + i));
+                        __m128i nxt = _mm_loadu_si128((const __m128i*)(src[k] + i + 1));
+                        dst[k][0] = _mm_or_si128(_mm_slli_epi64(cur, 1), _mm_srli_epi64(prev, LIFE_WORD_BITS - 1));
+                        dst[k][1] = cur;
+                        dst[k][2] = _mm_or_si128(_mm_srli_epi64(cur, 1), _mm_slli_epi64(nxt, LIFE_WORD_BITS - 1));
+                    }
+                    __m128i result = LifeRule(vUp[0], vUp[1], vUp[2], vMid[0], vMid[1], vMid[2], vDn[0], vDn[1], vDn[2]);
+                    _mm_storeu_si128((__m128i*)(out + i), result);
+                }
+#else
+                for(; i < words; i++)
+                {
+                    uint64_t n[3][3];
+                    const uint64_t* src[3] = { up, mid, dn };
+                    for(int k = 0; k < 3; k++)
+                    {
+                        uint64_t cur = src[k][i];
+                        n[k][0] = (cur << 1) | (src[k][i - 1] >> (LIFE_WORD_BITS - 1));
+                        n[k][1] = cur;
+                        n[k][2] = (cur >> 1) | (src[k][i + 1] << (LIFE_WORD_BITS - 1));
+                    }
+                    out[i] = LifeRule(n[0][0], n[0][1], n[0][2], n[1][0], n[1][1], n[1][2], n[2][0], n[2][1], n[2][2]);
+                }
+#endif
+                out[words - 1] &= lastMask;
+            }
+        }
+
+        // Non-copyable
+        LifeGrid(const LifeGrid &);
+        LifeGrid& operator=(const LifeGrid &);
+
+    public:
+        LifeGrid(int width, int height, LIFE_EDGES edgeMode = LIFE_TOROIDAL) : edges(edgeMode), generation(0)
+        {
+            w = width < 1 ? 1 : width;
+            h = height < 1 ? 1 : height;
+            words = (w + LIFE_WORD_BITS - 1) / LIFE_WORD_BITS;
+            stride = words + 2;
+            int tail = w % LIFE_WORD_BITS;
+            lastMask = tail == 0 ? ~(uint64_t)0 : (((uint64_t)1 << tail) - 1);
+
+            // Vector loads run up to one word past the last pad row
+            size_t total = (size_t)(h + 2) * stride + 2;
+            cells = (uint64_t*)alignedMalloc(sizeof(uint64_t) * total);
+            next = (uint64_t*)alignedMalloc(sizeof(uint64_t) * total);
+            memset(cells, 0, sizeof(uint64_t) * total);
+            memset(next, 0, sizeof(uint64_t) * total);
+        }
+
+        ~LifeGrid()
+        {
+            alignedFree(cells);
+            alignedFree(next);
+        }
+
+        int width() const { return w; }
+        int height() const { return h; }
+        uint64_t generations() const { return generation; }
+        LIFE_EDGES edgeMode() const { return edges; }
+
+        bool get(const int & x, const int & y) const
+        {
+            if(x < 0 || x >= w || y < 0 || y >= h)
+            {
+                return false;
+            }
+            return (row(y)[x / LIFE_WORD_BITS] >> (x % LIFE_WORD_BITS)) & 1;
+        }
+
+        void set(const int & x, const int & y, const bool & alive)
+        {
+            if(x < 0 || x >= w || y < 0 || y >= h)
+            {
+                return;
+            }
+            uint64_t bit = (uint64_t)1 << (x % LIFE_WORD_BITS);
+            uint64_t & word = row(cells, y)[x / LIFE_WORD_BITS];
+            word = alive ? (word | bit) : (word & ~bit);
+        }
+
+        void toggle(const int & x, const int & y)
+        {
+            set(x, y, !get(x, y));
+        }
+
+        void clear()
+        {
+            for(int y = 0; y < h; y++)
+            {
+                memset(row(cells, y), 0, sizeof(uint64_t) * words);
+            }
+            generation = 0;
+        }
+
+        // Each cell alive with probability 'density', repeatable per seed
+        void randomize(uint64_t seed, const double & density = 0.5)
+        {
+            uint32_t threshold = (uint32_t)(density * 4294967295.0);
+            seed = seed == 0 ? 0x9e3779b97f4a7c15ull : seed;
+            for(int y = 0; y < h; y++)
+            {
+                uint64_t* r = row(cells, y);
+                for(int i = 0; i < words; i++)
+                {
+                    uint64_t word = 0;
+                    for(int b = 0; b < LIFE_WORD_BITS; b++)
+                    {
+                        // xorshift64*
+                        seed ^= seed >> 12;
+                        seed ^= seed << 25;
+                        seed ^= seed >> 27;
+                        uint32_t sample = (uint32_t)((seed * 0x2545f4914f6cdd1dull) >> 32);
+                        word |= (uint64_t)(sample < threshold) << b;
+                    }
+                    r[i] = word;
+                }
+                r[words - 1] &= lastMask;
+            }
+            generation = 0;
+        }
+
+        // Live cells
+        uint64_t population() const
+        {
+            uint64_t count = 0;
+            for(int y = 0; y < h; y++)
+            {
+                const uint64_t* r = row(y);
+                for(int i = 0; i < words; i++)
+                {
+                    uint64_t word = i == words - 1 ? r[i] & lastMask : r[i];
+                    count += std::bitset<LIFE_WORD_BITS>(word).count();
+                }
+            }
+            return count;
+        }
+
+        // Advance one generation, bands of rows spread over 'pool'
+        void step(WorkerPool & pool)
+        {
+            fillPads();
+            int bands = pool.size() * LIFE_BANDS_PER_THREAD;
+            bands = bands > h ? h : bands;
+            int rowsPerBand = (h + bands - 1) / bands;
+            pool.parallelFor(bands, [&](int b, int)
+            {
+                int y0 = b * rowsPerBand;
+                int y1 = y0 + rowsPerBand < h ? y0 + rowsPerBand : h;
+                stepRows(y0, y1);
+            });
+            std::swap(cells, next);
+            generation++;
+        }
+
+        // Advance one generation on the calling thread
+        void step()
+        {
+            fillPads();
+            stepRows(0, h);
+            std::swap(cells, next);
+            generation++;
+        }
+
+        /**************************************************
+         * Upscales the cells from ('originX', 'originY')
+         * onwards into 'target', 'scale' pixels per cell.
+         * Grid row 0 is the bottom row of the frame.
+         *************************************************/
+        void draw(Buffer2D<PIXEL> & target, const int & originX, const int & originY, const int & scale,
+                  const PIXEL & alive = 0xffff0000, const PIXEL & dead = 0xff000000) const
+        {
+            int s = scale < 1 ? 1 : scale;
+            for(int ty = 0; ty < target.height(); ty++)
+            {
+                PIXEL* out = target[ty];
+                int y = originY + ty / s;
+                if(y < 0 || y >= h)
+                {
+                    for(int tx = 0; tx < target.width(); tx++)
+                    {
+                        out[tx] = dead;
+                    }
+                    continue;
+                }
+
+                const uint64_t* r = row(y);
+                for(int tx = 0; tx < target.width(); tx += s)
+                {
+                    int x = originX + tx / s;
+                    bool on = x >= 0 && x < w && ((r[x / LIFE_WORD_BITS] >> (x % LIFE_WORD_BITS)) & 1);
+                    PIXEL color = on ? alive : dead;
+                    int end = tx + s < target.width() ? tx + s : target.width();
+                    for(int px = tx; px < end; px++)
+                    {
+                        out[px] = color;
+                    }
+                }
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "definitions.h"
+#include "halfspace.h"
+#include "tiles.h"
+#include "clipping.h"
+
+#ifndef LINES_H
+#define LINES_H
+
+/******************************************************
+ * Integer division rounding toward -infinity and
+ * +infinity, for any signs.
+ *****************************************************/
+inline int64_t FloorDiv(const int64_t & a, const int64_t & b)
+{
+    int64_t q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+inline int64_t CeilDiv(const int64_t & a, const int64_t & b)
+{
+    return -FloorDiv(-a, b);
+}
+
+/******************************************************
+ * LINE_OUTCODE / CLIP_LINE_TO_RECT:
+ * Cohen-Sutherland outcodes against a pixel rectangle
+ * grown by one pixel reject segments entirely to one
+ * side of it. Segments that fit the snapping range are
+ * then kept whole, the rasterizer clips them exactly 
+ * in integers. Only those reaching past it get a 
+ * Liang-Barsky clip of the screen-space segment, which
+ * leaves their endpoints just outside every pixel the
+ * rectangle can write. Attributes and w are still 
+ * linear in screen space here. Returns false if 
+ * nothing is left.
+ *****************************************************/
+inline int LineOutcode(const Vertex & v, const ScreenRect & rect)
+{
+    return (v.x < rect.x0 - 1 ? 1 : 0) | (v.x > rect.x1 + 1 ? 2 : 0) |
+           (v.y < rect.y0 - 1 ? 4 : 0) | (v.y > rect.y1 + 1 ? 8 : 0);
+}
+
+inline bool ClipLineToRect(Vertex v[2], Attributes a[2], const ScreenRect & rect)
+{
+    if((LineOutcode(v[0], rect) & LineOutcode(v[1], rect)) != 0)
+    {
+        return false;
+    }
+    if(InSnapRange(v[0]) && InSnapRange(v[1]))
+    {
+        return true;
+    }
+
+    // Parametric limits along v0 + (v1 - v0) * t
+    double dx = v[1].x - v[0].x;
+    double dy = v[1].y - v[0].y;
+    double p[4] = {-dx, dx, -dy, dy};
+    double q[4] = {v[0].x - (rect.x0 - 1), (rect.x1 + 1) - v[0].x,
+                   v[0].y - (rect.y0 - 1), (rect.y1 + 1) - v[0].y};
+    double t0 = 0;
+    double t1 = 1;
+    for(int i = 0; i < 4; i++)
+    {
+        if(p[i] == 0)
+        {
+            if(q[i] < 0)
+            {
+                return false;
+            }
+            continue;
+        }
+        double t = q[i] / p[i];
+        if(p[i] < 0)
+        {
+            t0 = t > t0 ? t : t0;
+        }
+        else
+        {
+            t1 = t < t1 ? t : t1;
+        }
+    }
+    if(t0 >= t1)
+    {
+        return false;
+    }
+
+    Vertex ends[2] = {v[0], v[1]};
+    Attributes endAttrs[2] = {a[0], a[1]};
+    for(int i = 0; i < 2; i++)
+    {
+        double t = i == 0 ? t0 : t1;
+        if(t > 0 && t < 1)
+        {
+            v[i] = LerpVertex(ends[0], ends[1], t);
+            a[i] = Attributes(endAttrs[0], endAttrs[1], t);
+        }
+    }
+    return true;
+}
+
+/******************************************************
+ * LINE_SETUP:
+ * A snapped segment prepared for integer stepping. The
+ * major axis is whichever of x and y the line moves
+ * along more; it is mirrored when the line runs
+ * backwards, so stepping always goes up by one pixel.
+ * Pixel p (major axis, mirrored) is drawn when its
+ * center lies in [start, end) along the line, which
+ * draws every joint of a polyline exactly once. Its
+ * minor-axis pixel is the one containing the line at
+ * that center:
+ *      row(p) = floor(num(p) / denom)
+ *      num(p) = numFirst + numStep * (p - pFirst)
+ * all in exact 64-bit integers.
+ *
+ * Attribute slots and w are planes along the major
+ * axis, anchored at 'pFirst', so a pixel interpolates
+ * the same in any tile.
+ *****************************************************/
+struct LineSetup
+{
+    bool xMajor;
+    bool mirrored;
+    int pFirst;
+    int pEnd;
+    int64_t numFirst;
+    int64_t numStep;
+    int64_t denom;
+
+    alignas(16) float base[MAX_ATTRIBUTES];
+    alignas(16) float step[MAX_ATTRIBUTES];
+    float wBase;
+    float wStep;
+};
+
+inline bool SetupLine(const RasterVertex* v, const Attributes* a, LineSetup & s)
+{
+    int dx = v[1].x - v[0].x;
+    int dy = v[1].y - v[0].y;
+    if(dx == 0 && dy == 0)
+    {
+        return false;
+    }
+
+    s.xMajor = ABS(dx) >= ABS(dy);
+    int u0 = s.xMajor ? v[0].x : v[0].y;
+    int du = s.xMajor ? dx : dy;
+    int m0 = s.xMajor ? v[0].y : v[0].x;
+    int dm = s.xMajor ? dy : dx;
+    s.mirrored = du < 0;
+    if(s.mirrored)
+    {
+        // Pixel p has center -(p * ONE + ONE / 2), that is pixel -p - 1
+        u0 = -u0;
+        du = -du;
+    }
+
+    // First pixel center at or after the start, first one at or after the end
+    const int half = SUBPIXEL_ONE / 2;
+    s.pFirst = (int)CeilDiv(u0 - half, SUBPIXEL_ONE);
+    s.pEnd = (int)CeilDiv(u0 + du - half, SUBPIXEL_ONE);
+    if(s.pFirst >= s.pEnd)
+    {
+        return false;
+    }
+
+    int64_t along = (int64_t)s.pFirst * SUBPIXEL_ONE + half - u0;
+    s.denom = (int64_t)du * SUBPIXEL_ONE;
+    s.numFirst = (int64_t)m0 * du + along * dm;
+    s.numStep = (int64_t)dm * SUBPIXEL_ONE;
+
+    float tFirst = (float)along / du;
+    float tStep = (float)SUBPIXEL_ONE / du;
+    for(int k = 0; k < MAX_ATTRIBUTES; k++)
+    {
+        float delta = a[1].value[k] - a[0].value[k];
+        s.base[k] = a[0].value[k] + delta * tFirst;
+        s.step[k] = delta * tStep;
+    }
+    s.wBase = v[0].w + (v[1].w - v[0].w) * tFirst;
+    s.wStep = (v[1].w - v[0].w) * tStep;
+    return true;
+}
+
+/******************************************************
+ * CLIP_LINE_SPAN:
+ * Range [p0, p1) of major-axis pixels that land inside
+ * 'rect', solved exactly from the row equation instead
+ * of testing pixels. Returns false if it is empty.
+ *****************************************************/
+inline bool ClipLineSpan(const LineSetup & s, const ScreenRect & rect, int & p0, int & p1)
+{
+    int64_t lo = s.xMajor ? rect.x0 : rect.y0;
+    int64_t hi = s.xMajor ? rect.x1 : rect.y1;
+    int64_t minorLo = (int64_t)(s.xMajor ? rect.y0 : rect.x0) * s.denom - s.numFirst;
+    int64_t minorHi = (int64_t)(s.xMajor ? rect.y1 : rect.x1) * s.denom - s.numFirst;
+    if(s.mirrored)
+    {
+        int64_t t = -hi;
+        hi = -lo;
+        lo = t;
+    }
+
+    // Offsets k = p - pFirst with minorLo <= numStep * k < minorHi
+    int64_t k0 = lo - s.pFirst > 0 ? lo - s.pFirst : 0;
+    int64_t k1 = (hi < s.pEnd ? hi : s.pEnd) - s.pFirst;
+    if(s.numStep > 0)
+    {
+        k0 = std::max(k0, CeilDiv(minorLo, s.numStep));
+        k1 = std::min(k1, CeilDiv(minorHi, s.numStep));
+    }
+    else if(s.numStep < 0)
+    {
+        k0 = std::max(k0, FloorDiv(minorHi, s.numStep) + 1);
+        k1 = std::min(k1, FloorDiv(minorLo, s.numStep) + 1);
+    }
+    else if(minorLo > 0 || minorHi <= 0)
+    {
+        return false;
+    }
+    if(k0 >= k1)
+    {
+        return false;
+    }
+
+    p0 = s.pFirst + (int)k0;
+    p1 = s.pFirst + (int)k1;
+    return true;
+}
+
+#endif
@@ -0,0 +1,232 @@
+#include "definitions.h"
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+// Vertices transformed together by one SIMD block
+#define VERTEX_BLOCK 4
+
+/******************************************************
+ * MATRIX:
+ * 4x4 row-major float transform. Vertices are column
+ * vectors, so 'a * b' applies b first. Kept in float
+ * so four vertices transform in one pass of SSE math.
+ *****************************************************/
+class Matrix
+{
+    public:
+        alignas(16) float m[4][4];
+
+        // Identity
+        Matrix()
+        {
+            for(int r = 0; r < 4; r++)
+            {
+                for(int c = 0; c < 4; c++)
+                {
+                    m[r][c] = r == c ? 1.0f : 0.0f;
+                }
+            }
+        }
+
+        Matrix operator*(const Matrix & rhs) const
+        {
+            Matrix out;
+            for(int r = 0; r < 4; r++)
+            {
+                for(int c = 0; c < 4; c++)
+                {
+                    out.m[r][c] = m[r][0] * rhs.m[0][c] + m[r][1] * rhs.m[1][c] +
+                                  m[r][2] * rhs.m[2][c] + m[r][3] * rhs.m[3][c];
+                }
+            }
+            return out;
+        }
+
+        static Matrix translate(const double & x, const double & y, const double & z)
+        {
+            Matrix out;
+            out.m[0][3] = (float)x;
+            out.m[1][3] = (float)y;
+            out.m[2][3] = (float)z;
+            return out;
+        }
+
+        static Matrix scale(const double & x, const double & y, const double & z)
+        {
+            Matrix out;
+            out.m[0][0] = (float)x;
+            out.m[1][1] = (float)y;
+            out.m[2][2] = (float)z;
+            return out;
+        }
+
+        // Rotations in radians, counter-clockwise looking down the axis
+        static Matrix rotateX(const double & angle)
+        {
+            Matrix out;
+            float c = (float)cos(angle), s = (float)sin(angle);
+            out.m[1][1] = c; out.m[1][2] = -s;
+            out.m[2][1] = s; out.m[2][2] = c;
+            return out;
+        }
+
+        static Matrix rotateY(const double & angle)
+        {
+            Matrix out;
+            float c = (float)cos(angle), s = (float)sin(angle);
+            out.m[0][0] = c;  out.m[0][2] = s;
+            out.m[2][0] = -s; out.m[2][2] = c;
+            return out;
+        }
+
+        static Matrix rotateZ(const double & angle)
+        {
+            Matrix out;
+            float c = (float)cos(angle), s = (float)sin(angle);
+            out.m[0][0] = c; out.m[0][1] = -s;
+            out.m[1][0] = s; out.m[1][1] = c;
+            return out;
+        }
+
+        // OpenGL style projection looking down -z, fovY in radians
+        static Matrix perspective(const double & fovY, const double & aspect, const double & zNear, const double & zFar)
+        {
+            Matrix out;
+            double f = 1.0 / tan(fovY / 2);
+            out.m[0][0] = (float)(f / aspect);
+            out.m[1][1] = (float)f;
+            out.m[2][2] = (float)((zFar + zNear) / (zNear - zFar));
+            out.m[2][3] = (float)(2 * zFar * zNear / (zNear - zFar));
+            out.m[3][2] = -1.0f;
+            out.m[3][3] = 0.0f;
+            return out;
+        }
+};
+
+/******************************************************
+ * Transforms exactly VERTEX_BLOCK vertices. The block
+ * is transposed into x, y, z, w lanes (SoA) so each
+ * output component is four multiply-adds across four
+ * vertices at once. The scalar path performs the same
+ * float operations in the same order.
+ *****************************************************/
+inline void TransformBlock(const Matrix & mat, const Vertex* in, Vertex* out)
+{
+#ifdef HAS_SSE2
+    __m128 r0 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(&in[0].x)), _mm_cvtpd_ps(_mm_loadu_pd(&in[0].z)));
+    __m128 r1 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(&in[1].x)), _mm_cvtpd_ps(_mm_loadu_pd(&in[1].z)));
+    __m128 r2 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(&in[2].x)), _mm_cvtpd_ps(_mm_loadu_pd(&in[2].z)));
+    __m128 r3 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(&in[3].x)), _mm_cvtpd_ps(_mm_loadu_pd(&in[3].z)));
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    __m128 lanes[4];
+    for(int r = 0; r < 4; r++)
+    {
+        lanes[r] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(mat.m[r][0]), r0),
+                                                    _mm_mul_ps(_mm_set1_ps(mat.m[r][1]), r1)),
+                                         _mm_mul_ps(_mm_set1_ps(mat.m[r][2]), r2)),
+                              _mm_mul_ps(_mm_set1_ps(mat.m[r][3]), r3));
+    }
+    _MM_TRANSPOSE4_PS(lanes[0], lanes[1], lanes[2], lanes[3]);
+
+    for(int i = 0; i < VERTEX_BLOCK; i++)
+    {
+        _mm_storeu_pd(&out[i].x, _mm_cvtps_pd(lanes[i]));
+        _mm_storeu_pd(&out[i].z, _mm_cvtps_pd(_mm_movehl_ps(lanes[i], lanes[i])));
+    }
+#else
+    for(int i = 0; i < VERTEX_BLOCK; i++)
+    {
+        float v[4] = { (float)in[i].x, (float)in[i].y, (float)in[i].z, (float)in[i].w };
+        float o[4];
+        for(int r = 0; r < 4; r++)
+        {
+            o[r] = ((mat.m[r][0] * v[0] + mat.m[r][1] * v[1]) + mat.m[r][2] * v[2]) + mat.m[r][3] * v[3];
+        }
+        out[i].x = o[0];
+        out[i].y = o[1];
+        out[i].z = o[2];
+        out[i].w = o[3];
+    }
+#endif
+}
+
+/******************************************************
+ * Transforms 'count' vertices. A ragged tail is padded
+ * into a full block so every vertex takes the same
+ * path. 'in' and 'out' may be the same array.
+ *****************************************************/
+inline void TransformVertices(const Matrix & mat, const Vertex* in, Vertex* out, const int & count)
+{
+    int full = count - count % VERTEX_BLOCK;
+    for(int i = 0; i < full; i += VERTEX_BLOCK)
+    {
+        TransformBlock(mat, in + i, out + i);
+    }
+    if(full < count)
+    {
+        Vertex padIn[VERTEX_BLOCK] = {};
+        Vertex padOut[VERTEX_BLOCK];
+        for(int i = full; i < count; i++)
+        {
+            padIn[i - full] = in[i];
+        }
+        TransformBlock(mat, padIn, padOut);
+        for(int i = full; i < count; i++)
+        {
+            out[i] = padOut[i - full];
+        }
+    }
+}
+
+/******************************************************
+ * MATRIX_VERT_SHADER:
+ * Built-in vertex shader functor: position times
+ * 'mat', attributes passed through. The vertex stage
+ * recognizes it and shades whole arrays in SIMD
+ * blocks instead of one callback per vertex.
+ *****************************************************/
+struct MatrixVertShader
+{
+    static const bool concurrent = true;    // Only reads 'mat'
+    const Matrix* mat;
+
+    MatrixVertShader(const Matrix* m) : mat(m)
+    {
+    }
+
+    inline void operator()(Vertex & vertOut, Attributes & attrOut, const Vertex & vertIn, const Attributes & vertAttr, const Attributes & uniforms) const
+    {
+        TransformVertices(*mat, &vertIn, &vertOut, 1);
+        attrOut = vertAttr;
+    }
+};
+
+/******************************************************
+ * SHADE_VERTICES:
+ * Runs a vertex shader over a contiguous run. The
+ * generic version invokes the callback per vertex;
+ * overloads provide batched versions for built-ins.
+ *****************************************************/
+template <class VertT>
+inline void ShadeVertices(const VertT & vert, const Vertex* inputVerts, const Attributes* inputAttrs, const int & count,
+                          const Attributes & uniforms, Vertex* outVerts, Attributes* outAttrs)
+{
+    for(int i = 0; i < count; i++)
+    {
+        vert(outVerts[i], outAttrs[i], inputVerts[i], inputAttrs[i], uniforms);
+    }
+}
+
+inline void ShadeVertices(const MatrixVertShader & vert, const Vertex* inputVerts, const Attributes* inputAttrs, const int & count,
+                          const Attributes & uniforms, Vertex* outVerts, Attributes* outAttrs)
+{
+    TransformVertices(*vert.mat, inputVerts, outVerts, count);
+    for(int i = 0; i < count; i++)
+    {
+        outAttrs[i] = inputAttrs[i];
+    }
+}
+
+#endif
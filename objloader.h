@@ -0,0 +1,518 @@
+#include "definitions.h"
+#include "bmpio.h"
+#include "threadpool.h"
+#include "vertexcache.h"
+#include <vector>
+#include <algorithm>
+#include <climits>
+
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+/******************************************************
+ * OBJ_MESH:
+ * An indexed triangle list ready for DrawElements.
+ * Every vertex is a position with w = 1 and these
+ * attribute slots, in order: u, v if the file has
+ * texture coordinates, then nx, ny, nz if it has
+ * normals. Corners that leave one out read zeros.
+ *****************************************************/
+struct ObjMesh
+{
+    std::vector<Vertex> verts;
+    std::vector<Attributes> attrs;
+    std::vector<unsigned int> indices;
+    bool hasTexCoords;
+    bool hasNormals;
+};
+
+/******************************************************
+ * Parsing helpers. The file is mapped, not a string,
+ * so every scan is bounded by 'end' rather than a
+ * terminator.
+ *****************************************************/
+#define OBJ_CHUNK_BYTES (1 << 20)
+
+enum OBJ_LINES {OBJ_OTHER, OBJ_POSITION, OBJ_TEXCOORD, OBJ_NORMAL, OBJ_FACE};
+
+// Elements referenced by a face corner, -1 where absent
+struct ObjCorner
+{
+    int position;
+    int texCoord;
+    int normal;
+};
+
+inline bool ObjIsBlank(const char & c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* ObjSkipBlanks(const char* p, const char* end)
+{
+    while(p < end && ObjIsBlank(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+inline const char* ObjLineEnd(const char* p, const char* end)
+{
+    const char* newline = (const char*)memchr(p, '\n', end - p);
+    return newline != NULL ? newline : end;
+}
+
+// Type of the line at 'p', which is moved past its keyword
+inline OBJ_LINES ObjLineType(const char* & p, const char* end)
+{
+    p = ObjSkipBlanks(p, end);
+    if(end - p < 2)
+    {
+        return OBJ_OTHER;
+    }
+    if(p[0] == 'f' && ObjIsBlank(p[1]))
+    {
+        p += 2;
+        return OBJ_FACE;
+    }
+    if(p[0] != 'v')
+    {
+        return OBJ_OTHER;
+    }
+    if(ObjIsBlank(p[1]))
+    {
+        p += 2;
+        return OBJ_POSITION;
+    }
+    if(end - p >= 3 && ObjIsBlank(p[2]) && (p[1] == 't' || p[1] == 'n'))
+    {
+        p += 3;
+        return p[-2] == 't' ? OBJ_TEXCOORD : OBJ_NORMAL;
+    }
+    return OBJ_OTHER;
+}
+
+// True at the end of a token: line end, blank or comment
+inline bool ObjTokenEnd(const char* p, const char* end)
+{
+    return p >= end || ObjIsBlank(*p) || *p == '#';
+}
+
+/******************************************************
+ * Decimal number, optionally signed, with fraction and
+ * exponent. Up to 18 significant digits are kept and
+ * scaled by an exact power of ten, which is accurate
+ * well past float precision and, unlike strtod, does
+ * not depend on the locale or on a terminator.
+ *****************************************************/
+inline bool ObjParseFloat(const char* & p, const char* end, float & out)
+{
+    static const double POWERS[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const uint64_t MANTISSA_LIMIT = 100000000000000000ull;
+
+    p = ObjSkipBlanks(p, end);
+    bool negative = p < end && *p == '-';
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+    {
+        if(mantissa < MANTISSA_LIMIT)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+        else
+        {
+            exponent++;
+        }
+    }
+    if(p < end && *p == '.')
+    {
+        for(p++; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+        {
+            if(mantissa < MANTISSA_LIMIT)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if(digits == 0)
+    {
+        return false;
+    }
+    if(p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negativeExp = p < end && *p == '-';
+        if(p < end && (*p == '-' || *p == '+'))
+        {
+            p++;
+        }
+        int e = 0;
+        if(p >= end || *p < '0' || *p > '9')
+        {
+            return false;
+        }
+        for(; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            e = e < 1000 ? e * 10 + (*p - '0') : e;
+        }
+        exponent += negativeExp ? -e : e;
+    }
+
+    double value = (double)mantissa;
+    for(; exponent > 22; exponent -= 22)
+    {
+        value *= 1e22;
+    }
+    for(; exponent < -22; exponent += 22)
+    {
+        value /= 1e22;
+    }
+    value = exponent >= 0 ? value * POWERS[exponent] : value / POWERS[-exponent];
+    out = (float)(negative ? -value : value);
+    return ObjTokenEnd(p, end);
+}
+
+// Element reference: 1-based, or negative counting back from 'seen'
+inline bool ObjParseIndex(const char* & p, const char* end, const int & seen, int & out)
+{
+    bool negative = p < end && *p == '-';
+    if(negative)
+    {
+        p++;
+    }
+    if(p >= end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+    int64_t value = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        value = value < INT_MAX ? value * 10 + (*p - '0') : value;
+    }
+    int64_t resolved = negative ? seen - value : value - 1;
+    out = resolved >= 0 && resolved < INT_MAX ? (int)resolved : INT_MAX;
+    return value != 0;
+}
+
+// One face corner: v, v/vt, v//vn or v/vt/vn
+inline bool ObjParseCorner(const char* & p, const char* end, const int seen[3], ObjCorner & corner)
+{
+    corner.texCoord = -1;
+    corner.normal = -1;
+    if(!ObjParseIndex(p, end, seen[0], corner.position))
+    {
+        return false;
+    }
+    if(p < end && *p == '/')
+    {
+        p++;
+        if(p < end && *p != '/' && !ObjParseIndex(p, end, seen[1], corner.texCoord))
+        {
+            return false;
+        }
+        if(p < end && *p == '/')
+        {
+            p++;
+            if(!ObjParseIndex(p, end, seen[2], corner.normal))
+            {
+                return false;
+            }
+        }
+    }
+    return ObjTokenEnd(p, end);
+}
+
+/******************************************************
+ * OBJ_CHUNK:
+ * A run of whole lines parsed by one task. The first
+ * pass counts its elements and triangles, the second
+ * writes them at the chunk's offsets in the shared
+ * arrays, so no per-chunk lists need merging and
+ * relative (negative) indices resolve in place.
+ *****************************************************/
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+    int counts[4];          // Positions, texture coordinates, normals, triangles
+    int bases[4];           // Same, in the whole file before this chunk
+    bool failed;
+};
+
+inline void ObjCountChunk(ObjChunk & chunk)
+{
+    memset(chunk.counts, 0, sizeof(chunk.counts));
+    for(const char* line = chunk.begin; line < chunk.end; )
+    {
+        const char* lineEnd = ObjLineEnd(line, chunk.end);
+        const char* p = line;
+        OBJ_LINES type = ObjLineType(p, lineEnd);
+        if(type == OBJ_FACE)
+        {
+            // Faces are fans, one triangle per corner past the second
+            int corners = 0;
+            for(p = ObjSkipBlanks(p, lineEnd); p < lineEnd && *p != '#'; p = ObjSkipBlanks(p, lineEnd))
+            {
+                corners++;
+                while(!ObjTokenEnd(p, lineEnd))
+                {
+                    p++;
+                }
+            }
+            chunk.counts[3] += corners > 2 ? corners - 2 : 0;
+        }
+        else if(type != OBJ_OTHER)
+        {
+            chunk.counts[type - OBJ_POSITION]++;
+        }
+        line = lineEnd + 1;
+    }
+}
+
+inline void ObjParseChunk(ObjChunk & chunk, float* positions, float* texCoords, float* normals, ObjCorner* corners)
+{
+    static const int WIDTHS[3] = {3, 2, 3};
+    float* outputs[3] = {positions, texCoords, normals};
+    int seen[4];
+    memcpy(seen, chunk.bases, sizeof(seen));
+    chunk.failed = false;
+
+    for(const char* line = chunk.begin; line < chunk.end && !chunk.failed; )
+    {
+        const char* lineEnd = ObjLineEnd(line, chunk.end);
+        const char* p = line;
+        OBJ_LINES type = ObjLineType(p, lineEnd);
+        if(type == OBJ_FACE)
+        {
+            ObjCorner first;
+            ObjCorner previous;
+            int count = 0;
+            for(p = ObjSkipBlanks(p, lineEnd); p < lineEnd && *p != '#'; p = ObjSkipBlanks(p, lineEnd))
+            {
+                ObjCorner corner;
+                if(!ObjParseCorner(p, lineEnd, seen, corner))
+                {
+                    chunk.failed = true;
+                    break;
+                }
+                if(count == 0)
+                {
+                    first = corner;
+                }
+                else if(count >= 2)
+                {
+                    ObjCorner* tri = &corners[3 * seen[3]++];
+                    tri[0] = first;
+                    tri[1] = previous;
+                    tri[2] = corner;
+                }
+                previous = corner;
+                count++;
+            }
+        }
+        else if(type != OBJ_OTHER)
+        {
+            // Missing trailing components (a 'vt' with only u) read zero
+            int slot = type - OBJ_POSITION;
+            float* out = &outputs[slot][WIDTHS[slot] * seen[slot]++];
+            for(int k = 0; k < WIDTHS[slot]; k++)
+            {
+                out[k] = 0.0f;
+                p = ObjSkipBlanks(p, lineEnd);
+                if(p < lineEnd && *p != '#' && !ObjParseFloat(p, lineEnd, out[k]))
+                {
+                    chunk.failed = true;
+                }
+            }
+        }
+        line = lineEnd + 1;
+    }
+}
+
+/******************************************************
+ * LOAD_OBJ:
+ * Reads a Wavefront OBJ file into 'mesh'. The file is
+ * memory-mapped and cut into chunks at line breaks;
+ * 'pool' counts and then parses the chunks in
+ * parallel. Only v, vt, vn and f lines are read, and
+ * polygons are split into triangle fans.
+ *
+ * Corners are then deduplicated in file order: each
+ * distinct (position, uv, normal) triple becomes one
+ * vertex. The lookup is a hash table keyed by the
+ * position index, one chain per position holding its
+ * uv/normal variants, which are few in practice. The
+ * result is one compact vertex array and a 32-bit
+ * index buffer. With 'optimizeCache', triangles are
+ * reordered for vertex reuse (OptimizeVertexCache) and
+ * vertices renumbered in order of first use, so the
+ * vertex fetch walks memory forward.
+ *
+ * Returns false, leaving 'mesh' empty, if the file
+ * cannot be read, is malformed, or references missing
+ * elements.
+ *****************************************************/
+inline bool LoadOBJ(const char* path, ObjMesh & mesh, WorkerPool & pool, const bool & optimizeCache = true)
+{
+    mesh.verts.clear();
+    mesh.attrs.clear();
+    mesh.indices.clear();
+    mesh.hasTexCoords = false;
+    mesh.hasNormals = false;
+
+    MappedFile file(path);
+    if(file.data == NULL)
+    {
+        return false;
+    }
+
+    // Chunks of whole lines
+    const char* data = (const char*)file.data;
+    const char* dataEnd = data + file.size;
+    std::vector<ObjChunk> chunks;
+    for(const char* p = data; p < dataEnd; )
+    {
+        ObjChunk chunk = {};
+        chunk.begin = p;
+        chunk.end = dataEnd - p > OBJ_CHUNK_BYTES ? ObjLineEnd(p + OBJ_CHUNK_BYTES, dataEnd) : dataEnd;
+        chunk.end = chunk.end < dataEnd ? chunk.end + 1 : dataEnd;
+        chunks.push_back(chunk);
+        p = chunk.end;
+    }
+
+    pool.parallelFor((int)chunks.size(), [&](int c, int)
+    {
+        ObjCountChunk(chunks[c]);
+    });
+    int64_t totals[4] = {0, 0, 0, 0};
+    for(size_t c = 0; c < chunks.size(); c++)
+    {
+        for(int k = 0; k < 4; k++)
+        {
+            chunks[c].bases[k] = (int)totals[k];
+            totals[k] += chunks[c].counts[k];
+        }
+    }
+    if(totals[0] >= INT_MAX || totals[1] >= INT_MAX || totals[2] >= INT_MAX || totals[3] * 3 >= INT_MAX)
+    {
+        return false;
+    }
+
+    std::vector<float> positions(3 * totals[0]);
+    std::vector<float> texCoords(2 * totals[1]);
+    std::vector<float> normals(3 * totals[2]);
+    std::vector<ObjCorner> corners(3 * totals[3]);
+    pool.parallelFor((int)chunks.size(), [&](int c, int)
+    {
+        ObjParseChunk(chunks[c], positions.data(), texCoords.data(), normals.data(), corners.data());
+    });
+    for(size_t c = 0; c < chunks.size(); c++)
+    {
+        if(chunks[c].failed)
+        {
+            return false;
+        }
+    }
+
+    // One vertex per distinct corner, chained off its position
+    int numCorners = (int)corners.size();
+    std::vector<int> chainHead(totals[0], -1);
+    std::vector<int> chainNext;
+    std::vector<ObjCorner> unique;
+    mesh.indices.resize(numCorners);
+    for(int i = 0; i < numCorners; i++)
+    {
+        const ObjCorner & corner = corners[i];
+        if(corner.position >= totals[0] || corner.texCoord >= totals[1] || corner.normal >= totals[2])
+        {
+            mesh.indices.clear();
+            return false;
+        }
+
+        int v = chainHead[corner.position];
+        while(v >= 0 && (unique[v].texCoord != corner.texCoord || unique[v].normal != corner.normal))
+        {
+            v = chainNext[v];
+        }
+        if(v < 0)
+        {
+            v = (int)unique.size();
+            unique.push_back(corner);
+            chainNext.push_back(chainHead[corner.position]);
+            chainHead[corner.position] = v;
+        }
+        mesh.indices[i] = (unsigned int)v;
+    }
+    std::vector<int>().swap(chainHead);
+    std::vector<int>().swap(chainNext);
+    std::vector<ObjCorner>().swap(corners);
+
+    if(optimizeCache)
+    {
+        OptimizeVertexCache(mesh.indices.data(), numCorners, (int)unique.size());
+
+        // Renumber in order of first use
+        std::vector<int> remap(unique.size(), -1);
+        std::vector<ObjCorner> reordered(unique.size());
+        int used = 0;
+        for(int i = 0; i < numCorners; i++)
+        {
+            int & slot = remap[mesh.indices[i]];
+            if(slot < 0)
+            {
+                reordered[used] = unique[mesh.indices[i]];
+                slot = used++;
+            }
+            mesh.indices[i] = (unsigned int)slot;
+        }
+        unique.swap(reordered);
+    }
+
+    // Build the pipeline's vertices in parallel slices
+    mesh.hasTexCoords = totals[1] > 0;
+    mesh.hasNormals = totals[2] > 0;
+    int numVerts = (int)unique.size();
+    int sliceSize = OBJ_CHUNK_BYTES / sizeof(Attributes);
+    mesh.verts.resize(numVerts);
+    mesh.attrs.resize(numVerts);
+    pool.parallelFor((numVerts + sliceSize - 1) / sliceSize, [&](int s, int)
+    {
+        int last = std::min(numVerts, (s + 1) * sliceSize);
+        for(int i = s * sliceSize; i < last; i++)
+        {
+            const ObjCorner & corner = unique[i];
+            const float* pos = &positions[3 * corner.position];
+            Vertex vert = {pos[0], pos[1], pos[2], 1};
+            Attributes attr;
+            if(mesh.hasTexCoords)
+            {
+                const float* uv = corner.texCoord >= 0 ? &texCoords[2 * corner.texCoord] : NULL;
+                attr.insertDbl(uv != NULL ? uv[0] : 0.0);
+                attr.insertDbl(uv != NULL ? uv[1] : 0.0);
+            }
+            if(mesh.hasNormals)
+            {
+                const float* n = corner.normal >= 0 ? &normals[3 * corner.normal] : NULL;
+                for(int k = 0; k < 3; k++)
+                {
+                    attr.insertDbl(n != NULL ? n[k] : 0.0);
+                }
+            }
+            mesh.verts[i] = vert;
+            mesh.attrs[i] = attr;
+        }
+    });
+    return true;
+}
+
+#endif
@@ -1,33 +1,27 @@
 #include "definitions.h"
 #include "coursefunctions.h"
+#include "tiles.h"
+#include "halfspace.h"
+#include "vertexcache.h"
+#include "stats.h"
+#include "clipping.h"
+#include "cull.h"
+#include "lines.h"
+#include "points.h"
+#include "commandbuffer.h"
+#include "viewport.h"
+#include "matrix.h"
+#include "present.h"
 
 /***********************************************
  * CLEAR_SCREEN
  * Sets the screen to the indicated color value.
+ * Uses wide stores over the whole frame, or is
+ * deferred per tile when lazy clears are on.
  **********************************************/
 void clearScreen(Buffer2D<PIXEL> & frame, PIXEL color = 0xff000000)
 {
-    int h = frame.height();
-    int w = frame.width();
-    for(int y = 0; y < h; y++)
-    {
-        for(int x = 0; x < w; x++)
-        {
-            frame[y][x] = color;
-        }
-    }
-}
-
-/************************************************************
- * UPDATE_SCREEN
- * Blits pixels from RAM to VRAM for rendering.
- ***********************************************************/
-void SendFrame(SDL_Texture* GPU_OUTPUT, SDL_Renderer * ren, SDL_Surface* frameBuf) 
-{
-    SDL_UpdateTexture(GPU_OUTPUT, NULL, frameBuf->pixels, frameBuf->pitch);
-    SDL_RenderClear(ren);
-    SDL_RenderCopy(ren, GPU_OUTPUT, NULL, NULL);
-    SDL_RenderPresent(ren);
+    GetTileRenderer().clearTarget(frame, color);
 }
 
 /*************************************************************
@@ -53,23 +47,655 @@ void processUserInputs(bool & running)
     }
 }
 
+/*************************************************************
+ * RASTERIZE_POINT
+ * Shades the pixel holding the snapped point, if it is 
+ * inside 'clip' and passes the depth test.
+ ************************************************************/
+template <class FragT>
+void RasterizePoint(const TriangleJob & job, const ScreenRect & clip, const FragT & shade)
+{
+    const RasterVertex & v = job.verts[0];
+    int x = v.x >> SUBPIXEL_BITS;
+    int y = v.y >> SUBPIXEL_BITS;
+    if(x < clip.x0 || x >= clip.x1 || y < clip.y0 || y >= clip.y1)
+    {
+        return;
+    }
+    PIPELINE_STAT(fragmentsGenerated, 1);
+
+    if(job.zBuf != NULL)
+    {
+        float & z = (*job.zBuf)[y][x];
+        if(v.w <= z)
+        {
+            PIPELINE_STAT(fragmentsDepthRejected, 1);
+            return;
+        }
+        z = v.w;
+        float & coarseNear = job.zBuf->blockNear(x, y);
+        coarseNear = v.w > coarseNear ? v.w : coarseNear;
+    }
+
+    FragmentQuad quad;
+    memset(&quad.grad, 0, sizeof(quad.grad));
+    for(int lane = 0; lane < QUAD_LANES; lane++)
+    {
+        quad.frag[lane].numMembers = job.attrs[0].numMembers;
+        quad.frag[lane].ptrImg = job.attrs[0].ptrImg;
+        quad.frag[lane].grad = &quad.grad;
+    }
+    VaryingScale(quad.frag[0].value, job.attrs[0].value, 1.0f / v.w);
+    quad.mask = 1;
+    quad.x = x;
+    quad.y = y;
+    quad.color[0] = (*job.target)[y][x];
+    ShadeQuad(shade, quad, job.uniforms);
+    (*job.target)[y][x] = quad.color[0];
+    PIPELINE_STAT(fragmentsShaded, 1);
+}
+
+template <class FragT>
+void RasterizePointJob(const TriangleJob & job, const ScreenRect & clip)
+{
+    RasterizePoint(job, clip, *(const FragT*)job.shader);
+}
+
 /****************************************
  * DRAW_POINT
  * Renders a point to the screen with the
- * appropriate coloring.
+ * appropriate coloring. Queued like a
+ * triangle; for whole clouds use 
+ * DrawPointCloud instead.
  ***************************************/
-void DrawPoint(Buffer2D<PIXEL> & target, Vertex* v, Attributes* attrs, Attributes * const uniforms, FragmentShader* const frag)
+template <class FragT>
+void DrawPointWith(Buffer2D<PIXEL> & target, Vertex* v, Attributes* attrs, Attributes * const uniforms, const FragT & frag,
+                   DepthBuffer* zBuf)
+{
+    static_assert(sizeof(FragT) <= MAX_SHADER_STATE, "Fragment shader state too large, capture by pointer");
+    static_assert(std::is_trivially_copyable<FragT>::value, "Fragment shader must be trivially copyable");
+
+    // Past the snapping range a point is past every target
+    if(!InSnapRange(v[0]))
+    {
+        return;
+    }
+
+    TriangleJob job;
+    for(int i = 0; i < 3; i++)
+    {
+        job.verts[i] = SnapVertex(v[0]);
+        job.attrs[i] = attrs[0];
+    }
+    if(uniforms != NULL)
+    {
+        job.uniforms = *uniforms;
+    }
+    job.raster = RasterizePointJob<FragT>;
+    memcpy(job.shader, &frag, sizeof(FragT));
+    job.target = &target;
+    job.zBuf = zBuf;
+    job.bounds = DrawBounds(GetViewportState(), target);
+
+    PIPELINE_STAT(primitivesRasterized, 1);
+    TileRenderer & tiles = GetTileRenderer();
+    if(tiles.threads() > 1)
+    {
+        StageTimer timer(STAGE_BIN);
+        tiles.submit(job);
+    }
+    else
+    {
+        // Drawn now, a lazy clear left from threaded frames settles first
+        StageTimer timer(STAGE_RASTER);
+        if(zBuf != NULL)
+        {
+            zBuf->resolveClears();
+        }
+        RasterizePoint(job, job.bounds, frag);
+    }
+}
+
+void DrawPoint(Buffer2D<PIXEL> & target, Vertex* v, Attributes* attrs, Attributes * const uniforms, FragmentShader* const frag,
+               DepthBuffer* zBuf = NULL)
+{
+    DrawPointWith(target, v, attrs, uniforms, FragShaderAdapter(frag), zBuf);
+}
+
+/*************************************************************
+ * DRAW_POINT_CLOUD
+ * Point-list mode for large clouds read straight from SoA 
+ * arrays: no per-point Attributes or shader calls, points 
+ * are transformed by 'mvp' in bulk, binned by tile and 
+ * splatted as 'pointSize' square sprites in parallel (see 
+ * points.h). Ordered with queued triangles, confined to the
+ * viewport and scissor like every draw.
+ ************************************************************/
+void DrawPointCloud(Buffer2D<PIXEL> & target, const PointCloud & cloud, const Matrix & mvp, DepthBuffer* zBuf, int pointSize)
+{
+    GetPointRenderer().draw(target, cloud, mvp, zBuf, pointSize);
+}
+
+/*************************************************************
+ * RASTERIZE_LINE
+ * Integer line rasterizer. Steps the major axis one pixel at
+ * a time and carries the minor axis with a Bresenham 
+ * quotient and remainder, over only the span ClipLineSpan 
+ * finds inside 'clip', so no pixel is bounds checked. Each
+ * pixel is shaded as a single-lane quad whose gradients run
+ * along the line. Rows follow from the snapped endpoints 
+ * alone, so any tiling produces the same pixels.
+ ************************************************************/
+template <class FragT>
+void RasterizeLine(const TriangleJob & job, const ScreenRect & clip, const FragT & shade)
+{
+    LineSetup line;
+    int p0;
+    int p1;
+    if(!SetupLine(job.verts, job.attrs, line) || !ClipLineSpan(line, clip, p0, p1))
+    {
+        return;
+    }
+    Buffer2D<PIXEL> & target = *job.target;
+    DepthBuffer* depth = job.zBuf;
+
+    // Minor axis at p0, then its per-pixel step (quotient is -1, 0 or 1)
+    int64_t num = line.numFirst + line.numStep * (p0 - line.pFirst);
+    int64_t minor = FloorDiv(num, line.denom);
+    int64_t rem = num - minor * line.denom;
+    int64_t minorStep = FloorDiv(line.numStep, line.denom);
+    int64_t remStep = line.numStep - minorStep * line.denom;
+
+    FragmentQuad quad;
+    for(int lane = 0; lane < QUAD_LANES; lane++)
+    {
+        quad.frag[lane].numMembers = job.attrs[0].numMembers;
+        quad.frag[lane].ptrImg = job.attrs[0].ptrImg;
+        quad.frag[lane].grad = &quad.grad;
+    }
+    quad.mask = 1;
+    memset(&quad.grad, 0, sizeof(quad.grad));
+    float* alongGrad = line.xMajor ? quad.grad.ddx : quad.grad.ddy;
+    float gradSign = line.mirrored ? -1.0f : 1.0f;
+    Attributes & frag = quad.frag[0];
+    alignas(16) float vals[MAX_ATTRIBUTES];
+
+    uint64_t depthRejected = 0;
+    for(int p = p0; p < p1; p++)
+    {
+        int major = line.mirrored ? -p - 1 : p;
+        int x = line.xMajor ? major : (int)minor;
+        int y = line.xMajor ? (int)minor : major;
+        float k = (float)(p - line.pFirst);
+        float w = line.wBase + line.wStep * k;
+
+        minor += minorStep;
+        rem += remStep;
+        if(rem >= line.denom)
+        {
+            minor++;
+            rem -= line.denom;
+        }
+
+        if(depth != NULL)
+        {
+            float & z = (*depth)[y][x];
+            if(w <= z)
+            {
+                depthRejected++;
+                continue;
+            }
+            z = w;
+            float & coarseNear = depth->blockNear(x, y);
+            coarseNear = w > coarseNear ? w : coarseNear;
+        }
+
+        // Perspective correct value, and its derivative along the line
+        float invW = 1.0f / w;
+        VaryingMulAdd(vals, line.base, line.step, k);
+        VaryingScale(frag.value, vals, invW);
+        VaryingMulAdd(alongGrad, line.step, frag.value, -line.wStep);
+        VaryingScale(alongGrad, alongGrad, invW * gradSign);
+
+        quad.x = x;
+        quad.y = y;
+        quad.color[0] = target[y][x];
+        ShadeQuad(shade, quad, job.uniforms);
+        target[y][x] = quad.color[0];
+    }
+
+    PIPELINE_STAT(fragmentsGenerated, p1 - p0);
+    PIPELINE_STAT(fragmentsDepthRejected, depthRejected);
+    PIPELINE_STAT(fragmentsShaded, p1 - p0 - depthRejected);
+}
+
+template <class FragT>
+void RasterizeLineJob(const TriangleJob & job, const ScreenRect & clip)
 {
-    // Your code goes here
+    RasterizeLine(job, clip, *(const FragT*)job.shader);
 }
 
 /****************************************
- * DRAW_TRIANGLE
- * Renders a line to the screen.
+ * DRAW_LINE
+ * Renders a line to the screen. The
+ * segment is clipped to the viewport and
+ * scissor up front, then queued like a
+ * triangle so it keeps its place among
+ * them. Depth tested against 'zBuf' when 
+ * one is given.
  ***************************************/
-void DrawLine(Buffer2D<PIXEL> & target, Vertex* const triangle, Attributes* const attrs, Attributes* const uniforms, FragmentShader* const frag)
+template <class FragT>
+void DrawLineWith(Buffer2D<PIXEL> & target, Vertex* const line, Attributes* const attrs, Attributes* const uniforms, const FragT & frag,
+                  DepthBuffer* zBuf)
+{
+    static_assert(sizeof(FragT) <= MAX_SHADER_STATE, "Fragment shader state too large, capture by pointer");
+    static_assert(std::is_trivially_copyable<FragT>::value, "Fragment shader must be trivially copyable");
+
+    ScreenRect bounds = DrawBounds(GetViewportState(), target);
+    Vertex ends[2] = {line[0], line[1]};
+    Attributes endAttrs[2] = {attrs[0], attrs[1]};
+    if(!ClipLineToRect(ends, endAttrs, bounds))
+    {
+        return;
+    }
+
+    // The third vertex repeats the end, binning then sees the segment's bounds
+    TriangleJob job;
+    for(int i = 0; i < 3; i++)
+    {
+        job.verts[i] = SnapVertex(ends[i < 2 ? i : 1]);
+        job.attrs[i] = endAttrs[i < 2 ? i : 1];
+    }
+    if(uniforms != NULL)
+    {
+        job.uniforms = *uniforms;
+    }
+    job.raster = RasterizeLineJob<FragT>;
+    memcpy(job.shader, &frag, sizeof(FragT));
+    job.target = &target;
+    job.zBuf = zBuf;
+    job.bounds = bounds;
+
+    PIPELINE_STAT(primitivesRasterized, 1);
+    TileRenderer & tiles = GetTileRenderer();
+    if(tiles.threads() > 1)
+    {
+        StageTimer timer(STAGE_BIN);
+        tiles.submit(job);
+    }
+    else
+    {
+        // Drawn now, a lazy clear left from threaded frames settles first
+        StageTimer timer(STAGE_RASTER);
+        if(zBuf != NULL)
+        {
+            zBuf->resolveClears();
+        }
+        RasterizeLine(job, job.bounds, frag);
+    }
+}
+
+void DrawLine(Buffer2D<PIXEL> & target, Vertex* const line, Attributes* const attrs, Attributes* const uniforms, FragmentShader* const frag,
+              DepthBuffer* zBuf = NULL)
+{
+    DrawLineWith(target, line, attrs, uniforms, FragShaderAdapter(frag), zBuf);
+}
+
+/*************************************************************
+ * SET_RASTER_THREADS / SET_TILE_SIZE / FLUSH_PIPELINE
+ * Configure the tile back end. With a single thread every
+ * triangle is drawn immediately, which keeps debugging 
+ * simple. With more, triangles are queued until the next 
+ * flush, so flush before reading a target back or 
+ * presenting it.
+ ************************************************************/
+void SetRasterThreads(int count)
+{
+    GetTileRenderer().setThreads(count);
+}
+
+void SetTileSize(int size)
+{
+    GetTileRenderer().setTileSize(size);
+}
+
+void FlushPipeline()
+{
+    GetTileRenderer().flush();
+}
+
+/*************************************************************
+ * SET_LAZY_CLEAR / CLEAR_DEPTH / FINISH_FRAME
+ * With lazy clears on (and more than one thread), clearing 
+ * the screen or a depth buffer only flags each tile; a tile
+ * is filled the first time something is drawn into it. 
+ * FinishFrame fills the color tiles nothing touched, so it 
+ * must run before the frame is presented or read back.
+ ************************************************************/
+void SetLazyClear(bool lazy)
+{
+    GetTileRenderer().setLazyClear(lazy);
+}
+
+void ClearDepth(DepthBuffer & depth)
+{
+    GetTileRenderer().clearDepth(depth);
+}
+
+void FinishFrame()
+{
+    GetTileRenderer().finishFrame();
+}
+
+/*************************************************************
+ * SET_CLIPPING / SET_GUARD_BAND
+ * With clipping on, vertex shaders output clip-space 
+ * positions and the pipeline clips, normalizes and applies
+ * the viewport transform. The guard band is in NDC units 
+ * and never narrower than the viewport.
+ ************************************************************/
+void SetClipping(bool enabled)
+{
+    GetClipState().enabled = enabled;
+}
+
+void SetGuardBand(double guardBand)
+{
+    GetClipState().guardBand = guardBand < 1.0 ? 1.0 : guardBand;
+}
+
+/*************************************************************
+ * SET_VIEWPORT / SET_SCISSOR / SET_SCISSOR_TEST
+ * Rectangles in target pixels from the bottom-left corner.
+ * Every draw is confined to its viewport, and to the 
+ * scissor while the scissor test is on. A zero-sized 
+ * viewport (the default) covers the whole target.
+ ************************************************************/
+void SetViewport(int x, int y, int width, int height)
+{
+    ScreenRect rect = {x, y, x + (width > 0 ? width : 0), y + (height > 0 ? height : 0)};
+    GetViewportState().viewport = rect;
+}
+
+void SetScissor(int x, int y, int width, int height)
+{
+    ScreenRect rect = {x, y, x + (width > 0 ? width : 0), y + (height > 0 ? height : 0)};
+    GetViewportState().scissor = rect;
+}
+
+void SetScissorTest(bool enabled)
+{
+    GetViewportState().scissorTest = enabled;
+}
+
+/*************************************************************
+ * SET_CULL_MODE / SET_FRONT_FACE
+ * Facing-based culling, off by default. Degenerate and 
+ * off-screen triangles are culled regardless.
+ ************************************************************/
+void SetCullMode(CULL_MODES mode)
+{
+    GetCullState().mode = mode;
+}
+
+void SetFrontFace(WINDINGS winding)
+{
+    GetCullState().frontFace = winding;
+}
+
+/*************************************************************
+ * ENABLE_PIPELINE_STATS / RESET_PIPELINE_STATS / 
+ * GET_PIPELINE_STATS
+ * Statistics are off by default. Reset at the start of a 
+ * frame and read after FinishFrame for per-frame numbers.
+ ************************************************************/
+void EnablePipelineStats(bool enabled)
+{
+    FlushPipeline();
+    GetStatsState().enabled = enabled;
+}
+
+void ResetPipelineStats()
+{
+    GetStatsState().reset();
+}
+
+PipelineStats GetPipelineStats()
+{
+    return GetStatsState().snapshot();
+}
+
+/*************************************************************
+ * RASTERIZE_TRIANGLE
+ * Half-space rasterizer. Walks the triangle's bounding box
+ * (clipped to 'clip') in 4x4 blocks aligned to the screen,
+ * skipping blocks outside an edge, accepting blocks inside
+ * all three, and running the coverage kernel on the rest.
+ * Surviving pixels are shaded in 2x2 quads.
+ * Blocks sit on an absolute grid, so any tiling of the 
+ * screen (with tiles a multiple of the block size) 
+ * produces the same pixels.
+ ************************************************************/
+template <class FragT>
+void RasterizeTriangle(const TriangleJob & job, const ScreenRect & clip, const FragT & shade)
+{
+    const RasterVertex* v = job.verts;
+    Buffer2D<PIXEL> & target = *job.target;
+
+    EdgeSetup edges;
+    if(!SetupEdges(v, edges))
+    {
+        return;
+    }
+
+    // Pixels whose centers lie within the snapped bounds, clipped then 
+    // snapped out to whole blocks
+    const int half = SUBPIXEL_ONE / 2;
+    int x0 = (std::min(v[0].x, std::min(v[1].x, v[2].x)) + half - 1) >> SUBPIXEL_BITS;
+    int y0 = (std::min(v[0].y, std::min(v[1].y, v[2].y)) + half - 1) >> SUBPIXEL_BITS;
+    int x1 = ((std::max(v[0].x, std::max(v[1].x, v[2].x)) - half) >> SUBPIXEL_BITS) + 1;
+    int y1 = ((std::max(v[0].y, std::max(v[1].y, v[2].y)) - half) >> SUBPIXEL_BITS) + 1;
+    x0 = x0 < clip.x0 ? clip.x0 : x0;
+    y0 = y0 < clip.y0 ? clip.y0 : y0;
+    x1 = x1 > clip.x1 ? clip.x1 : x1;
+    y1 = y1 > clip.y1 ? clip.y1 : y1;
+    if(x0 >= x1 || y0 >= y1)
+    {
+        return;
+    }
+    int bx0 = x0 & ~(RASTER_BLOCK - 1);
+    int by0 = y0 & ~(RASTER_BLOCK - 1);
+
+    const int fullMask = (1 << (RASTER_BLOCK * RASTER_BLOCK)) - 1;
+    BlockCoverage cover;
+
+    // Attribute planes, and one fragment reused for every pixel
+    VaryingSetup vary;
+    SetupVaryings(v, job.attrs, edges, vary);
+    FragmentQuad quad;
+    for(int lane = 0; lane < QUAD_LANES; lane++)
+    {
+        quad.frag[lane].numMembers = job.attrs[0].numMembers;
+        quad.frag[lane].ptrImg = job.attrs[0].ptrImg;
+        quad.frag[lane].grad = &quad.grad;
+    }
+    alignas(16) float blockVals[MAX_ATTRIBUTES];
+    alignas(16) float quadVals[MAX_ATTRIBUTES];
+
+    // Fragment counters, added to the statistics once per call
+    bool counting = GetStatsState().enabled;
+    uint64_t generated = 0;
+    uint64_t depthRejected = 0;
+
+    // Depth range of the whole triangle bounds every block's range
+    DepthBuffer* depth = job.zBuf;
+    float triNear = std::max(v[0].w, std::max(v[1].w, v[2].w));
+    float triFar = std::min(v[0].w, std::min(v[1].w, v[2].w));
+
+    for(int by = by0; by < y1; by += RASTER_BLOCK)
+    {
+        for(int bx = bx0; bx < x1; bx += RASTER_BLOCK)
+        {
+            if(BlockOutside(edges, bx, by))
+            {
+                continue;
+            }
+
+            // Planes at the block's first pixel center, anchored absolutely
+            float offX = (float)(bx + 0.5 - vary.originX);
+            float offY = (float)(by + 0.5 - vary.originY);
+            float wBlock = vary.wBase + vary.wdx * offX + vary.wdy * offY;
+
+            // Hierarchical depth: drop blocks already covered by nearer pixels
+            float blockNear = 0;
+            float blockFar = 0;
+            if(depth != NULL)
+            {
+                float spanX = vary.wdx * (RASTER_BLOCK - 1);
+                float spanY = vary.wdy * (RASTER_BLOCK - 1);
+                blockNear = wBlock + (spanX > 0 ? spanX : 0) + (spanY > 0 ? spanY : 0);
+                blockFar  = wBlock + (spanX < 0 ? spanX : 0) + (spanY < 0 ? spanY : 0);
+                blockNear = blockNear < triNear ? blockNear : triNear;
+                blockFar  = blockFar  > triFar  ? blockFar  : triFar;
+                if(blockNear <= depth->blockFar(bx, by))
+                {
+                    continue;
+                }
+            }
+
+            int mask = fullMask;
+            if(!BlockInside(edges, bx, by))
+            {
+                BlockCoverageOf(edges, bx, by, cover);
+                mask = cover.mask;
+            }
+
+            // Drop lanes outside the clip rectangle
+            if(bx < x0 || by < y0 || bx + RASTER_BLOCK > x1 || by + RASTER_BLOCK > y1)
+            {
+                for(int lane = 0; lane < RASTER_BLOCK * RASTER_BLOCK; lane++)
+                {
+                    int x = bx + lane % RASTER_BLOCK;
+                    int y = by + lane / RASTER_BLOCK;
+                    if(x < x0 || x >= x1 || y < y0 || y >= y1)
+                    {
+                        mask &= ~(1 << lane);
+                    }
+                }
+            }
+
+            if(mask == 0)
+            {
+                continue;
+            }
+            if(counting)
+            {
+                generated += MaskBits(mask);
+            }
+
+            // Early-Z: depth test the whole block before any shading. A block
+            // whose farthest point is clearly nearer than every stored pixel 
+            // passes outright and only writes its depth; the margin covers
+            // rounding between the bound and the per-pixel planes
+            if(depth != NULL)
+            {
+                float & coarseFar = depth->blockFar(bx, by);
+                float & coarseNear = depth->blockNear(bx, by);
+                bool covered = mask == fullMask;
+                bool inFront = blockFar * (1.0f - DEPTH_BOUND_MARGIN) > coarseNear;
+                int passed = inFront ? mask : 0;
+                for(int r = 0; r < RASTER_BLOCK; r++)
+                {
+                    int rowMask = (mask >> (r * RASTER_BLOCK)) & ((1 << RASTER_BLOCK) - 1);
+                    if(rowMask == 0)
+                    {
+                        continue;
+                    }
+                    float* zRow = (*depth)[by + r] + bx;
+                    if(inFront)
+                    {
+                        DepthWriteRow(zRow, wBlock + vary.wdy * r, vary.wdx, rowMask);
+                    }
+                    else
+                    {
+                        passed |= EarlyDepthTest(zRow, wBlock + vary.wdy * r, vary.wdx, rowMask) << (r * RASTER_BLOCK);
+                    }
+                }
+                if(counting)
+                {
+                    depthRejected += MaskBits(mask & ~passed);
+                }
+                mask = passed;
+
+                // Every covered pixel now holds at least max(old far, blockFar)
+                if(covered && blockFar > coarseFar)
+                {
+                    coarseFar = blockFar;
+                }
+                if(mask != 0 && blockNear > coarseNear)
+                {
+                    coarseNear = blockNear;
+                }
+                if(mask == 0)
+                {
+                    continue;
+                }
+            }
+
+            VaryingMulAdd(blockVals, vary.base, vary.dx, offX);
+            VaryingMulAdd(blockVals, blockVals, vary.dy, offY);
+
+            // Shade the block as four 2x2 quads, helper lanes included
+            for(int q = 0; q < 4; q++)
+            {
+                int qc = (q & 1) * 2;
+                int qr = (q >> 1) * 2;
+                int quadMask = QuadMask(mask, qc, qr);
+                if(quadMask == 0)
+                {
+                    continue;
+                }
+                quad.mask = quadMask;
+                quad.x = bx + qc;
+                quad.y = by + qr;
+
+                // Perspective correct: slots were pre-multiplied by 1/w
+                VaryingMulAdd(quadVals, blockVals, vary.dx, (float)qc);
+                VaryingMulAdd(quadVals, quadVals, vary.dy, (float)qr);
+                InterpolateQuad(vary, quadVals, wBlock + vary.wdx * qc + vary.wdy * qr, quad);
+                QuadGradients(quad);
+                for(int lane = 0; lane < QUAD_LANES; lane++)
+                {
+                    bool covered = (quadMask >> lane) & 1;
+                    quad.color[lane] = covered ? target[quad.y + (lane >> 1)][quad.x + (lane & 1)] : 0;
+                }
+
+                ShadeQuad(shade, quad, job.uniforms);
+                for(int lane = 0; lane < QUAD_LANES; lane++)
+                {
+                    if((quadMask >> lane) & 1)
+                    {
+                        target[quad.y + (lane >> 1)][quad.x + (lane & 1)] = quad.color[lane];
+                    }
+                }
+            }
+        }
+    }
+
+    PIPELINE_STAT(fragmentsGenerated, generated);
+    PIPELINE_STAT(fragmentsDepthRejected, depthRejected);
+    PIPELINE_STAT(fragmentsShaded, generated - depthRejected);
+}
+
+/*************************************************************
+ * RASTERIZE_JOB
+ * Entry point stored in queued jobs, recovers the shader 
+ * object copied into the job.
+ ************************************************************/
+template <class FragT>
+void RasterizeJob(const TriangleJob & job, const ScreenRect & clip)
 {
-    // Your code goes here
+    RasterizeTriangle(job, clip, *(const FragT*)job.shader);
 }
 
 /*************************************************************
@@ -77,16 +703,99 @@ void DrawLine(Buffer2D<PIXEL> & target, Vertex* const triangle, Attributes* cons
  * Renders a triangle to the target buffer. Essential 
  * building block for most of drawing.
  ************************************************************/
-void DrawTriangle(Buffer2D<PIXEL> & target, Vertex* const triangle, Attributes* const attrs, Attributes* const uniforms, FragmentShader* const frag)
+template <class FragT>
+void DrawTriangleWith(Buffer2D<PIXEL> & target, Vertex* const triangle, Attributes* const attrs, Attributes* const uniforms, const FragT & frag,
+                      DepthBuffer* zBuf)
+{
+    static_assert(sizeof(FragT) <= MAX_SHADER_STATE, "Fragment shader state too large, capture by pointer");
+    static_assert(std::is_trivially_copyable<FragT>::value, "Fragment shader must be trivially copyable");
+
+    TriangleJob job;
+    for(int i = 0; i < 3; i++)
+    {
+        job.verts[i] = SnapVertex(triangle[i]);
+        job.attrs[i] = attrs[i];
+    }
+    if(uniforms != NULL)
+    {
+        job.uniforms = *uniforms;
+    }
+    job.raster = RasterizeJob<FragT>;
+    memcpy(job.shader, &frag, sizeof(FragT));
+    job.target = &target;
+    job.zBuf = zBuf;
+    job.bounds = DrawBounds(GetViewportState(), target);
+
+    PIPELINE_STAT(primitivesRasterized, 1);
+    TileRenderer & tiles = GetTileRenderer();
+    if(tiles.threads() > 1)
+    {
+        StageTimer timer(STAGE_BIN);
+        tiles.submit(job);
+    }
+    else
+    {
+        // Drawn now, a lazy clear left from threaded frames settles first
+        StageTimer timer(STAGE_RASTER);
+        if(zBuf != NULL)
+        {
+            zBuf->resolveClears();
+        }
+        RasterizeTriangle(job, job.bounds, frag);
+    }
+}
+
+void DrawTriangle(Buffer2D<PIXEL> & target, Vertex* const triangle, Attributes* const attrs, Attributes* const uniforms, FragmentShader* const frag,
+                  DepthBuffer* zBuf = NULL)
 {
-    // Your code goes here
+    // Cut to the snapping range first, like the pipeline does
+    Vertex verts[MAX_VERTICES] = {triangle[0], triangle[1], triangle[2]};
+    Attributes vertAttrs[MAX_VERTICES] = {attrs[0], attrs[1], attrs[2]};
+    int numVerts = ClipToSnapRange(verts, vertAttrs, 3);
+    for(int i = 1; i + 1 < numVerts; i++)
+    {
+        Vertex fanVerts[3] = {verts[0], verts[i], verts[i + 1]};
+        Attributes fanAttrs[3] = {vertAttrs[0], vertAttrs[i], vertAttrs[i + 1]};
+        DrawTriangleWith(target, fanVerts, fanAttrs, uniforms, FragShaderAdapter(frag), zBuf);
+    }
 }
 
 /**************************************************************
  * VERTEX_SHADER_EXECUTE_VERTICES
  * Executes the vertex shader on inputs, yielding transformed
- * outputs. 
+ * outputs. Large arrays are split into chunks of whole SIMD
+ * blocks shaded across the worker pool when 'vert' opts in 
+ * (ConcurrentVertShader); callbacks run on this thread.
  *************************************************************/
+#define VERTEX_CHUNK 1024
+
+template <class VertT>
+void VertexShaderExecuteVerticesWith(const VertT & vert, Vertex const inputVerts[], Attributes const inputAttrs[], const int& numIn, 
+                                     Attributes* const uniforms, Vertex transformedVerts[], Attributes transformedAttrs[])
+{
+    StageTimer timer(STAGE_VERTEX);
+    PIPELINE_STAT(verticesShaded, numIn);
+
+    static const Attributes noUniforms;
+    const Attributes & uniformsIn = uniforms != NULL ? *uniforms : noUniforms;
+
+    WorkerPool & pool = GetTileRenderer().workers();
+    int chunks = (numIn + VERTEX_CHUNK - 1) / VERTEX_CHUNK;
+    if(pool.size() == 1 || chunks < 2 || !ConcurrentVertShader(vert, 0))
+    {
+        ShadeVertices(vert, inputVerts, inputAttrs, numIn, uniformsIn, transformedVerts, transformedAttrs);
+        return;
+    }
+
+    pool.parallelFor(chunks, [&](int c, int)
+    {
+        int first = c * VERTEX_CHUNK;
+        int count = numIn - first < VERTEX_CHUNK ? numIn - first : VERTEX_CHUNK;
+        ShadeVertices(vert, inputVerts + first, inputAttrs + first, count, uniformsIn,
+                      transformedVerts + first, transformedAttrs + first);
+    });
+}
+
 void VertexShaderExecuteVertices(const VertexShader* vert, Vertex const inputVerts[], Attributes const inputAttrs[], const int& numIn, 
                                  Attributes* const uniforms, Vertex transformedVerts[], Attributes transformedAttrs[])
 {
@@ -98,6 +807,144 @@ void VertexShaderExecuteVertices(const VertexShader* vert, Vertex const inputVer
             transformedVerts[i] = inputVerts[i];
             transformedAttrs[i] = inputAttrs[i];
         }
+        return;
+    }
+
+    VertexShaderExecuteVerticesWith(VertShaderAdapter(vert), inputVerts, inputAttrs, numIn, uniforms, transformedVerts, transformedAttrs);
+}
+
+/**************************************************************
+ * VERTICES_PER_PRIMITIVE
+ * Number of vertices making up one primitive of 'prim'.
+ *************************************************************/
+int VerticesPerPrimitive(PRIMITIVES prim)
+{
+    switch(prim)
+    {
+        case POINT:
+            return 1;
+        case LINE:
+            return 2;
+        case TRIANGLE:
+            return 3;
+    }
+    return 0;
+}
+
+/**************************************************************
+ * DRAW_SHADED_PRIMITIVE
+ * Runs the stages after vertex transformation on a single 
+ * primitive whose vertices are already shaded.
+ *************************************************************/
+template <class FragT>
+void DrawShadedPrimitive(PRIMITIVES prim,
+                         Buffer2D<PIXEL>& target,
+                         Vertex transformedVerts[],
+                         Attributes transformedAttrs[],
+                         Attributes* const uniforms,
+                         const FragT & frag,
+                         DepthBuffer* zBuf)
+{
+    PIPELINE_STAT(primitivesSubmitted, 1);
+
+    int numVerts = VerticesPerPrimitive(prim);
+    const ClipState & clip = GetClipState();
+    if(clip.enabled)
+    {
+        // Clipping, only against the planes some vertex is outside of,
+        // with the guard band kept inside the rasterizer's snapping range
+        ScreenRect view = ViewportRect(GetViewportState(), target);
+        double guard = fmin(clip.guardBand, RasterGuardBand(view.x0, view.y0, view.x1 - view.x0, view.y1 - view.y0));
+        {
+            StageTimer timer(STAGE_CLIP);
+            int anyOut = 0;
+            int allOut = ~0;
+            for(int i = 0; i < numVerts; i++)
+            {
+                int code = ClipOutcode(transformedVerts[i], guard);
+                anyOut |= code;
+                allOut &= code;
+            }
+            if(allOut != 0)
+            {
+                PIPELINE_STAT(primitivesClipped, 1);
+                return;
+            }
+            if(anyOut != 0)
+            {
+                PIPELINE_STAT(primitivesClipped, 1);
+                switch(prim)
+                {
+                    case POINT:
+                        return;
+                    case LINE:
+                        if(!ClipSegment(transformedVerts, transformedAttrs, anyOut, guard))
+                        {
+                            return;
+                        }
+                        break;
+                    case TRIANGLE:
+                        numVerts = ClipPolygon(transformedVerts, transformedAttrs, numVerts, anyOut, guard);
+                        if(numVerts < 3)
+                        {
+                            return;
+                        }
+                }
+            }
+        }
+
+        // Normalization
+        {
+            StageTimer timer(STAGE_NORMALIZE);
+            NormalizeVertices(transformedVerts, transformedAttrs, numVerts);
+        }
+
+        // ViewPort transform
+        {
+            StageTimer timer(STAGE_VIEWPORT);
+            ViewportTransform(transformedVerts, numVerts, view.x0, view.y0, view.x1 - view.x0, view.y1 - view.y0);
+        }
+    }
+
+    // Vertex Interpolation & Fragment Drawing
+    switch(prim)
+    {
+        case POINT:
+            DrawPointWith(target, transformedVerts, transformedAttrs, uniforms, frag, zBuf);
+            break;
+        case LINE:
+            DrawLineWith(target, transformedVerts, transformedAttrs, uniforms, frag, zBuf);
+            break;
+        case TRIANGLE:
+        {
+            // Screen-space geometry reaching past the snapping range is cut to it
+            numVerts = ClipToSnapRange(transformedVerts, transformedAttrs, numVerts);
+
+            // A clipped triangle is a convex polygon, drawn as a fan
+            ScreenRect bounds = DrawBounds(GetViewportState(), target);
+            for(int i = 1; i + 1 < numVerts; i++)
+            {
+                Vertex fanVerts[3] = {transformedVerts[0], transformedVerts[i], transformedVerts[i + 1]};
+
+                // Culling, on the positions the rasterizer will snap to
+                CULL_REASONS culled;
+                {
+                    StageTimer timer(STAGE_CULL);
+                    RasterVertex snapped[3] = {SnapVertex(fanVerts[0]), SnapVertex(fanVerts[1]), SnapVertex(fanVerts[2])};
+                    culled = CullTriangle(snapped, bounds, GetCullState());
+                }
+                if(culled != NUM_CULL_REASONS)
+                {
+                    PIPELINE_STAT(primitivesCulled, 1);
+                    PIPELINE_STAT(primitivesCulledBy[culled], 1);
+                    continue;
+                }
+
+                Attributes fanAttrs[3] = {transformedAttrs[0], transformedAttrs[i], transformedAttrs[i + 1]};
+                DrawTriangleWith(target, fanVerts, fanAttrs, uniforms, frag, zBuf);
+            }
+            break;
+        }
     }
 }
 
@@ -108,8 +955,30 @@ void VertexShaderExecuteVertices(const VertexShader* vert, Vertex const inputVer
  *  2) Clipping
  *  3) Normalization
  *  4) ViewPort transform
- *  5) Rasterization & Fragment Shading
+ *  5) Culling
+ *  6) Rasterization & Fragment Shading
  **************************************************************************/
+template <class FragT, class VertT>
+void DrawPrimitiveWith(PRIMITIVES prim, 
+                       Buffer2D<PIXEL>& target,
+                       const Vertex inputVerts[], 
+                       const Attributes inputAttrs[],
+                       Attributes* const uniforms,
+                       const FragT & frag,
+                       const VertT & vert,
+                       DepthBuffer* zBuf)
+{
+    // Setup count for vertices & attributes
+    int numIn = VerticesPerPrimitive(prim);
+
+    // Vertex shader 
+    Vertex transformedVerts[MAX_VERTICES];
+    Attributes transformedAttrs[MAX_VERTICES];
+    VertexShaderExecuteVerticesWith(vert, inputVerts, inputAttrs, numIn, uniforms, transformedVerts, transformedAttrs);
+
+    DrawShadedPrimitive(prim, target, transformedVerts, transformedAttrs, uniforms, frag, zBuf);
+}
+
 void DrawPrimitive(PRIMITIVES prim, 
                    Buffer2D<PIXEL>& target,
                    const Vertex inputVerts[], 
@@ -117,42 +986,246 @@ void DrawPrimitive(PRIMITIVES prim,
                    Attributes* const uniforms,
                    FragmentShader* const frag,                   
                    VertexShader* const vert,
-                   Buffer2D<double>* zBuf)
+                   DepthBuffer* zBuf)
 {
-    // Setup count for vertices & attributes
-    int numIn = 0;
-    switch(prim)
+    DrawPrimitiveWith(prim, target, inputVerts, inputAttrs, uniforms, FragShaderAdapter(frag), VertShaderAdapter(vert), zBuf);
+}
+
+/***************************************************************************
+ * SHADE_ELEMENTS / FETCH_SHADED
+ * Vertex stage of the indexed draws. ShadeElements starts the post-
+ * transform cache on the referenced index range (sequential indices when
+ * 'indices' is NULL, PRIMITIVE_RESTART entries skipped) and shades densely
+ * referenced ranges up front as one batch. FetchShaded then shades sparse
+ * vertices as they are first seen. Returns false if nothing is referenced.
+ **************************************************************************/
+#define VERTEX_BATCH_MIN 64
+
+template <class VertT>
+bool ShadeElements(PostTransformCache & cache,
+                   const Vertex inputVerts[],
+                   const Attributes inputAttrs[],
+                   const unsigned int indices[],
+                   const int & count,
+                   Attributes* const uniforms,
+                   const VertT & vert)
+{
+    // Only the referenced index range needs cache slots
+    unsigned int lo = PRIMITIVE_RESTART;
+    unsigned int hi = 0;
+    for(int i = 0; i < count; i++)
     {
-        case POINT:
-            numIn = 1;
-            break;
-        case LINE:
-            numIn = 2;
-            break;
-        case TRIANGLE:
-            numIn = 3;
-            break;
+        unsigned int idx = indices != NULL ? indices[i] : (unsigned int)i;
+        if(idx != PRIMITIVE_RESTART)
+        {
+            lo = idx < lo ? idx : lo;
+            hi = idx > hi ? idx : hi;
+        }
+    }
+    if(lo > hi)
+    {
+        return false;
+    }
+    cache.begin(lo, hi);
+
+    // Densely referenced ranges are shaded up front as one batch,
+    // sparse ones lazily as indices are first seen
+    unsigned int span = hi - lo + 1;
+    if(span >= VERTEX_BATCH_MIN && span <= (unsigned int)count)
+    {
+        Vertex* v;
+        Attributes* a;
+        cache.storeRange(lo, span, v, a);
+        VertexShaderExecuteVerticesWith(vert, &inputVerts[lo], &inputAttrs[lo], (int)span, uniforms, v, a);
+    }
+    return true;
+}
+
+template <class VertT>
+void FetchShaded(PostTransformCache & cache,
+                 const unsigned int & idx,
+                 const Vertex inputVerts[],
+                 const Attributes inputAttrs[],
+                 Attributes* const uniforms,
+                 const VertT & vert,
+                 Vertex & outVert,
+                 Attributes & outAttrs)
+{
+    if(!cache.contains(idx))
+    {
+        Vertex* v;
+        Attributes* a;
+        cache.store(idx, v, a);
+        VertexShaderExecuteVerticesWith(vert, &inputVerts[idx], &inputAttrs[idx], 1, uniforms, v, a);
+    }
+    outVert = cache.vertex(idx);
+    outAttrs = cache.attributes(idx);
+}
+
+/***************************************************************************
+ * DRAW_ELEMENTS
+ * Indexed, batched counterpart of DrawPrimitive. Draws 'count' indices 
+ * out of the shared vertex and attribute arrays, or the first 'count' 
+ * vertices in order when 'indices' is NULL. Every vertices-per-primitive
+ * consecutive indices make one primitive; a PRIMITIVE_RESTART index drops
+ * the primitive it interrupts and the next one starts after it, as do any
+ * indices left over at the end. Each distinct index runs the vertex shader
+ * once; later references are served from the post-transform cache. With 
+ * LINE this is the batch entry point for line lists.
+ **************************************************************************/
+template <class FragT, class VertT>
+void DrawElementsWith(PRIMITIVES prim,
+                      Buffer2D<PIXEL>& target,
+                      const Vertex inputVerts[],
+                      const Attributes inputAttrs[],
+                      const unsigned int indices[],
+                      const int & count,
+                      Attributes* const uniforms,
+                      const FragT & frag,
+                      const VertT & vert,
+                      DepthBuffer* zBuf)
+{
+    int perPrim = VerticesPerPrimitive(prim);
+    static PostTransformCache cache;
+    if(count < perPrim || !ShadeElements(cache, inputVerts, inputAttrs, indices, count, uniforms, vert))
+    {
+        return;
     }
 
-    // Vertex shader 
     Vertex transformedVerts[MAX_VERTICES];
     Attributes transformedAttrs[MAX_VERTICES];
-    VertexShaderExecuteVertices(vert, inputVerts, inputAttrs, numIn, uniforms, transformedVerts, transformedAttrs);
+    int k = 0;
+    for(int i = 0; i < count; i++)
+    {
+        unsigned int idx = indices != NULL ? indices[i] : (unsigned int)i;
+        if(idx == PRIMITIVE_RESTART)
+        {
+            k = 0;
+            continue;
+        }
 
-    // Vertex Interpolation & Fragment Drawing
-    switch(prim)
+        FetchShaded(cache, idx, inputVerts, inputAttrs, uniforms, vert, transformedVerts[k], transformedAttrs[k]);
+        if(++k == perPrim)
+        {
+            DrawShadedPrimitive(prim, target, transformedVerts, transformedAttrs, uniforms, frag, zBuf);
+            k = 0;
+        }
+    }
+}
+
+void DrawElements(PRIMITIVES prim,
+                  Buffer2D<PIXEL>& target,
+                  const Vertex inputVerts[],
+                  const Attributes inputAttrs[],
+                  const unsigned int indices[],
+                  const int & count,
+                  Attributes* const uniforms,
+                  FragmentShader* const frag,
+                  VertexShader* const vert,
+                  DepthBuffer* zBuf)
+{
+    DrawElementsWith(prim, target, inputVerts, inputAttrs, indices, count, uniforms, FragShaderAdapter(frag), VertShaderAdapter(vert), zBuf);
+}
+
+/***************************************************************************
+ * DRAW_LINE_STRIP
+ * Batch entry point for polylines. Draws connected segments through 
+ * 'count' indices, or through the first 'count' vertices when 'indices'
+ * is NULL; a PRIMITIVE_RESTART index ends one polyline and starts the 
+ * next, so a whole overlay is one call. Each vertex is shaded once and, 
+ * when inside the clip volume, normalized and viewport transformed once 
+ * for both segments it joins. Only segments with an endpoint outside go
+ * through the full clipping path.
+ **************************************************************************/
+template <class FragT, class VertT>
+void DrawLineStripWith(Buffer2D<PIXEL>& target,
+                       const Vertex inputVerts[],
+                       const Attributes inputAttrs[],
+                       const unsigned int indices[],
+                       const int & count,
+                       Attributes* const uniforms,
+                       const FragT & frag,
+                       const VertT & vert,
+                       DepthBuffer* zBuf)
+{
+    static PostTransformCache cache;
+    if(count < 2 || !ShadeElements(cache, inputVerts, inputAttrs, indices, count, uniforms, vert))
     {
-        case POINT:
-            DrawPoint(target, transformedVerts, transformedAttrs, uniforms, frag);
-            break;
-        case LINE:
-            DrawLine(target, transformedVerts, transformedAttrs, uniforms, frag);
-            break;
-        case TRIANGLE:
-            DrawTriangle(target, transformedVerts, transformedAttrs, uniforms, frag);
+        return;
+    }
+
+    const ClipState & clip = GetClipState();
+    ScreenRect view = ViewportRect(GetViewportState(), target);
+    double guard = fmin(clip.guardBand, RasterGuardBand(view.x0, view.y0, view.x1 - view.x0, view.y1 - view.y0));
+
+    // Both ends of the current segment, as shaded and in screen space
+    Vertex shadedVerts[2];
+    Attributes shadedAttrs[2];
+    Vertex screenVerts[2];
+    Attributes screenAttrs[2];
+    int codes[2] = {0, 0};
+    bool started = false;
+    for(int i = 0; i < count; i++)
+    {
+        unsigned int idx = indices != NULL ? indices[i] : (unsigned int)i;
+        if(idx == PRIMITIVE_RESTART)
+        {
+            started = false;
+            continue;
+        }
+
+        shadedVerts[0] = shadedVerts[1];
+        shadedAttrs[0] = shadedAttrs[1];
+        screenVerts[0] = screenVerts[1];
+        screenAttrs[0] = screenAttrs[1];
+        codes[0] = codes[1];
+
+        FetchShaded(cache, idx, inputVerts, inputAttrs, uniforms, vert, shadedVerts[1], shadedAttrs[1]);
+        screenVerts[1] = shadedVerts[1];
+        screenAttrs[1] = shadedAttrs[1];
+        if(clip.enabled)
+        {
+            codes[1] = ClipOutcode(shadedVerts[1], guard);
+            if(codes[1] == 0)
+            {
+                StageTimer timer(STAGE_VIEWPORT);
+                NormalizeVertices(&screenVerts[1], &screenAttrs[1], 1);
+                ViewportTransform(&screenVerts[1], 1, view.x0, view.y0, view.x1 - view.x0, view.y1 - view.y0);
+            }
+        }
+
+        if(started)
+        {
+            if((codes[0] | codes[1]) == 0)
+            {
+                PIPELINE_STAT(primitivesSubmitted, 1);
+                DrawLineWith(target, screenVerts, screenAttrs, uniforms, frag, zBuf);
+            }
+            else
+            {
+                Vertex transformedVerts[MAX_VERTICES] = {shadedVerts[0], shadedVerts[1]};
+                Attributes transformedAttrs[MAX_VERTICES] = {shadedAttrs[0], shadedAttrs[1]};
+                DrawShadedPrimitive(LINE, target, transformedVerts, transformedAttrs, uniforms, frag, zBuf);
+            }
+        }
+        started = true;
     }
 }
 
+void DrawLineStrip(Buffer2D<PIXEL>& target,
+                   const Vertex inputVerts[],
+                   const Attributes inputAttrs[],
+                   const unsigned int indices[],
+                   const int & count,
+                   Attributes* const uniforms,
+                   FragmentShader* const frag,
+                   VertexShader* const vert,
+                   DepthBuffer* zBuf)
+{
+    DrawLineStripWith(target, inputVerts, inputAttrs, indices, count, uniforms, FragShaderAdapter(frag), VertShaderAdapter(vert), zBuf);
+}
+
+#ifndef PIPELINE_NO_MAIN
 /*************************************************************
  * MAIN:
  * Main game loop, initialization, memory management
@@ -162,39 +1235,41 @@ int main()
     // -----------------------DATA TYPES----------------------
     SDL_Window* WIN;               // Our Window
     SDL_Renderer* REN;             // Interfaces CPU with GPU
-    SDL_Texture* GPU_OUTPUT;       // GPU buffer image (GPU Memory)
-    SDL_Surface* FRAME_BUF;        // CPU buffer image (Main Memory) 
 
     // ------------------------INITIALIZATION-------------------
     SDL_Init(SDL_INIT_EVERYTHING);
     WIN = SDL_CreateWindow(WINDOW_NAME, 200, 200, S_WIDTH, S_HEIGHT, 0);
     REN = SDL_CreateRenderer(WIN, -1, SDL_RENDERER_SOFTWARE);
-    FRAME_BUF = SDL_CreateRGBSurface(0, S_WIDTH, S_HEIGHT, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
-    FRAME_BUF = SDL_ConvertSurface(SDL_GetWindowSurface(WIN), SDL_GetWindowSurface(WIN)->format, 0);
-    GPU_OUTPUT = SDL_CreateTextureFromSurface(REN, FRAME_BUF);
-    BufferImage frame(FRAME_BUF);
+    SetRasterThreads(std::thread::hardware_concurrency());
+    SetLazyClear(true);
 
-    // Draw loop 
-    bool running = true;
-    while(running) 
-    {           
-        // Handle user inputs
-        processUserInputs(running);
+    // Double buffered frames, presented on their own thread
+    {
+        FramePresenter presenter(REN, S_WIDTH, S_HEIGHT);
 
-        // Refresh Screen
-        clearScreen(frame);
+        // Draw loop 
+        bool running = true;
+        while(running) 
+        {           
+            // Handle user inputs
+            processUserInputs(running);
 
-        // Your code goes here
+            // Refresh Screen
+            Buffer2D<PIXEL> & frame = presenter.frame();
+            clearScreen(frame);
 
-        // Push to the GPU
-        SendFrame(GPU_OUTPUT, REN, FRAME_BUF);
+            // Your code goes here
+
+            // Finish the frame and queue it, rendering continues
+            // into the next buffer while this one is presented
+            presenter.present();
+        }
     }
 
     // Cleanup
-    SDL_FreeSurface(FRAME_BUF);
-    SDL_DestroyTexture(GPU_OUTPUT);
     SDL_DestroyRenderer(REN);
     SDL_DestroyWindow(WIN);
     SDL_Quit();
     return 0;
 }
+#endif
@@ -0,0 +1,368 @@
+#include "definitions.h"
+#include "matrix.h"
+#include "clipping.h"
+#include "tiles.h"
+#include "viewport.h"
+#include "stats.h"
+#include <vector>
+
+#ifndef POINTS_H
+#define POINTS_H
+
+// Points per transform and binning task
+#define POINT_CHUNK 16384
+
+// Largest point sprite edge in pixels
+#define MAX_POINT_SIZE 64
+
+/******************************************************
+ * POINT_CLOUD:
+ * Caller-owned point data in flat SoA arrays, read in
+ * place. Positions are object space; 'color' may be
+ * NULL, every point then uses 'uniformColor'.
+ *****************************************************/
+struct PointCloud
+{
+    const float* x;
+    const float* y;
+    const float* z;
+    const PIXEL* color;
+    PIXEL uniformColor;
+    int count;
+};
+
+/******************************************************
+ * POINT_SPLAT:
+ * A transformed point: lower-left pixel of its
+ * sprite, depth (1/w, larger is nearer, 0 marks a
+ * culled point) and color.
+ *****************************************************/
+struct PointSplat
+{
+    int16_t x;
+    int16_t y;
+    float depth;
+    PIXEL color;
+};
+
+/******************************************************
+ * POINT_RENDERER:
+ * Draws whole point clouds in four passes:
+ *  1) transform: chunks of points go through the
+ *     matrix four at a time, are culled and projected
+ *     to sprite corners, counting splats per tile;
+ *  2) prefix sums turn the counts into each chunk's
+ *     write offset within each tile;
+ *  3) binning: chunks scatter their splats into one
+ *     array ordered by tile, then by point;
+ *  4) splatting: tiles are depth tested and written in
+ *     parallel through the tile renderer.
+ * A tile is only ever written by one thread and keeps
+ * point order, so the result matches drawing the
+ * points one by one. Scratch arrays are kept between
+ * draws.
+ *****************************************************/
+class PointRenderer
+{
+    private:
+        std::vector<PointSplat> projected;  // Point order
+        std::vector<PointSplat> binned;     // Tile order
+        std::vector<int> counts;            // [chunk][tile], then write offsets
+        std::vector<int> tileStart;         // First splat of each tile, plus end
+        std::vector<int> activeTiles;
+        std::vector<int> columnTile;        // Tile column of each pixel column in the bounds
+        std::vector<int> rowTile;
+
+        // Project points [first, first + count) into 'projected', four at a
+        // time: clip coordinates, culling, divide and sprite corners in SIMD
+        void transformChunk(const PointCloud & cloud, const Matrix & mat, const int & first, const int & count,
+                            const ScreenRect & view, const ScreenRect & bounds, const int & size)
+        {
+            // Corner = ceil(screen - offset), kept when the sprite overlaps 'bounds'
+            const float halfW = 0.5f * (view.x1 - view.x0);
+            const float halfH = 0.5f * (view.y1 - view.y0);
+            const float originX = view.x0 + halfW - (0.5f * size + 0.5f);
+            const float originY = view.y0 + halfH - (0.5f * size + 0.5f);
+            const int loX = bounds.x0 - size;
+            const int loY = bounds.y0 - size;
+
+#ifdef HAS_SSE2
+            __m128 rows[4][4];
+            for(int r = 0; r < 4; r++)
+            {
+                for(int c = 0; c < 4; c++)
+                {
+                    rows[r][c] = _mm_set1_ps(mat.m[r][c]);
+                }
+            }
+#endif
+            const float* srcX = cloud.x;
+            const float* srcY = cloud.y;
+            const float* srcZ = cloud.z;
+            PointSplat* out = &projected[0];
+
+            for(int i = first; i < first + count; i += 4)
+            {
+                int lanes = first + count - i < 4 ? first + count - i : 4;
+                // A ragged tail is padded into a full block
+                alignas(16) float pad[3][4] = {{0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}};
+                const float* pos[3] = {srcX + i, srcY + i, srcZ + i};
+                if(lanes < 4)
+                {
+                    for(int l = 0; l < lanes; l++)
+                    {
+                        pad[0][l] = srcX[i + l];
+                        pad[1][l] = srcY[i + l];
+                        pad[2][l] = srcZ[i + l];
+                    }
+                    pos[0] = pad[0];
+                    pos[1] = pad[1];
+                    pos[2] = pad[2];
+                }
+
+                alignas(16) int cornerX[4];
+                alignas(16) int cornerY[4];
+                alignas(16) float depth[4];
+#ifdef HAS_SSE2
+                __m128 clip[4];
+                for(int r = 0; r < 4; r++)
+                {
+                    clip[r] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rows[r][0], _mm_loadu_ps(pos[0])),
+                                                               _mm_mul_ps(rows[r][1], _mm_loadu_ps(pos[1]))),
+                                                    _mm_mul_ps(rows[r][2], _mm_loadu_ps(pos[2]))),
+                                         rows[r][3]);
+                }
+                __m128 visible = _mm_and_ps(_mm_cmpgt_ps(clip[3], _mm_set1_ps((float)CLIP_W_EPSILON)),
+                                            _mm_cmpge_ps(_mm_add_ps(clip[2], clip[3]), _mm_setzero_ps()));
+                __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), clip[3]);
+                __m128 fx = _mm_add_ps(_mm_set1_ps(originX), _mm_mul_ps(_mm_mul_ps(clip[0], invW), _mm_set1_ps(halfW)));
+                __m128 fy = _mm_add_ps(_mm_set1_ps(originY), _mm_mul_ps(_mm_mul_ps(clip[1], invW), _mm_set1_ps(halfH)));
+
+                // Only convert lanes well inside int range, then round up
+                visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpgt_ps(fx, _mm_set1_ps((float)loX - 1)), _mm_cmplt_ps(fx, _mm_set1_ps((float)bounds.x1))));
+                visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpgt_ps(fy, _mm_set1_ps((float)loY - 1)), _mm_cmplt_ps(fy, _mm_set1_ps((float)bounds.y1))));
+                fx = _mm_and_ps(fx, visible);
+                fy = _mm_and_ps(fy, visible);
+                __m128i ix = _mm_cvttps_epi32(fx);
+                __m128i iy = _mm_cvttps_epi32(fy);
+                ix = _mm_sub_epi32(ix, _mm_castps_si128(_mm_cmplt_ps(_mm_cvtepi32_ps(ix), fx)));
+                iy = _mm_sub_epi32(iy, _mm_castps_si128(_mm_cmplt_ps(_mm_cvtepi32_ps(iy), fy)));
+                _mm_store_si128((__m128i*)cornerX, ix);
+                _mm_store_si128((__m128i*)cornerY, iy);
+                _mm_store_ps(depth, _mm_and_ps(invW, visible));
+#else
+                for(int l = 0; l < 4; l++)
+                {
+                    float clip[4];
+                    for(int r = 0; r < 4; r++)
+                    {
+                        clip[r] = ((mat.m[r][0] * pos[0][l] + mat.m[r][1] * pos[1][l]) + mat.m[r][2] * pos[2][l]) + mat.m[r][3];
+                    }
+                    float invW = 1.0f / clip[3];
+                    float fx = originX + clip[0] * invW * halfW;
+                    float fy = originY + clip[1] * invW * halfH;
+                    bool visible = clip[3] > (float)CLIP_W_EPSILON && clip[2] + clip[3] >= 0 &&
+                                   fx > (float)loX - 1 && fx < (float)bounds.x1 && fy > (float)loY - 1 && fy < (float)bounds.y1;
+                    cornerX[l] = visible ? (int)fx : 0;
+                    cornerY[l] = visible ? (int)fy : 0;
+                    cornerX[l] += visible && cornerX[l] < fx ? 1 : 0;
+                    cornerY[l] += visible && cornerY[l] < fy ? 1 : 0;
+                    depth[l] = visible ? invW : 0;
+                }
+#endif
+
+                for(int l = 0; l < lanes; l++)
+                {
+                    PointSplat & splat = out[i + l];
+                    bool inside = cornerX[l] > loX && cornerX[l] < bounds.x1 && cornerY[l] > loY && cornerY[l] < bounds.y1;
+                    splat.x = (int16_t)cornerX[l];
+                    splat.y = (int16_t)cornerY[l];
+                    splat.depth = inside ? depth[l] : 0;
+                    splat.color = cloud.color != NULL ? cloud.color[i + l] : cloud.uniformColor;
+                }
+            }
+        }
+
+        // Tiles [tx0, tx1] x [ty0, ty1] a splat's sprite lands in, looked up
+        // per pixel column and row of 'bounds' rather than divided out
+        void splatTiles(const PointSplat & splat, const ScreenRect & bounds, const int & size,
+                        int & tx0, int & ty0, int & tx1, int & ty1) const
+        {
+            tx0 = columnTile[std::max((int)splat.x, bounds.x0) - bounds.x0];
+            ty0 = rowTile[std::max((int)splat.y, bounds.y0) - bounds.y0];
+            tx1 = columnTile[std::min(splat.x + size, bounds.x1) - 1 - bounds.x0];
+            ty1 = rowTile[std::min(splat.y + size, bounds.y1) - 1 - bounds.y0];
+        }
+
+    public:
+        void draw(Buffer2D<PIXEL> & target, const PointCloud & cloud, const Matrix & mat, DepthBuffer* zBuf, int size)
+        {
+            if(cloud.count <= 0)
+            {
+                return;
+            }
+            size = size < 1 ? 1 : (size > MAX_POINT_SIZE ? MAX_POINT_SIZE : size);
+
+            TileRenderer & tiles = GetTileRenderer();
+            WorkerPool & pool = tiles.workers();
+            int across;
+            int down;
+            tiles.tileGrid(target, across, down);
+            int numTiles = across * down;
+            int tile = tiles.tile();
+            ScreenRect view = ViewportRect(GetViewportState(), target);
+            ScreenRect bounds = DrawBounds(GetViewportState(), target);
+            if(bounds.x0 >= bounds.x1 || bounds.y0 >= bounds.y1)
+            {
+                return;
+            }
+
+            columnTile.resize(bounds.x1 - bounds.x0);
+            rowTile.resize(bounds.y1 - bounds.y0);
+            for(int x = bounds.x0; x < bounds.x1; x++)
+            {
+                columnTile[x - bounds.x0] = x / tile;
+            }
+            for(int y = bounds.y0; y < bounds.y1; y++)
+            {
+                rowTile[y - bounds.y0] = y / tile;
+            }
+
+            int chunks = (cloud.count + POINT_CHUNK - 1) / POINT_CHUNK;
+            projected.resize(cloud.count);
+            counts.assign((size_t)chunks * numTiles, 0);
+
+            // Transform, cull and count
+            {
+                StageTimer timer(STAGE_VERTEX);
+                pool.parallelFor(chunks, [&](int c, int)
+                {
+                    int first = c * POINT_CHUNK;
+                    int count = std::min(POINT_CHUNK, cloud.count - first);
+                    transformChunk(cloud, mat, first, count, view, bounds, size);
+
+                    int* chunkCounts = &counts[(size_t)c * numTiles];
+                    for(int i = first; i < first + count; i++)
+                    {
+                        const PointSplat & splat = projected[i];
+                        if(splat.depth == 0)
+                        {
+                            continue;
+                        }
+                        int tx0, ty0, tx1, ty1;
+                        splatTiles(splat, bounds, size, tx0, ty0, tx1, ty1);
+                        for(int ty = ty0; ty <= ty1; ty++)
+                        {
+                            for(int tx = tx0; tx <= tx1; tx++)
+                            {
+                                chunkCounts[ty * across + tx]++;
+                            }
+                        }
+                    }
+                });
+            }
+            PIPELINE_STAT(verticesShaded, cloud.count);
+            PIPELINE_STAT(primitivesSubmitted, cloud.count);
+
+            // Offsets: tiles in order, chunks in order within a tile
+            {
+                StageTimer timer(STAGE_BIN);
+                tileStart.resize(numTiles + 1);
+                activeTiles.clear();
+                int total = 0;
+                for(int t = 0; t < numTiles; t++)
+                {
+                    tileStart[t] = total;
+                    for(int c = 0; c < chunks; c++)
+                    {
+                        int n = counts[(size_t)c * numTiles + t];
+                        counts[(size_t)c * numTiles + t] = total;
+                        total += n;
+                    }
+                    if(total > tileStart[t])
+                    {
+                        activeTiles.push_back(t);
+                    }
+                }
+                tileStart[numTiles] = total;
+                if(total == 0)
+                {
+                    return;
+                }
+
+                binned.resize(total);
+                pool.parallelFor(chunks, [&](int c, int)
+                {
+                    int first = c * POINT_CHUNK;
+                    int count = std::min(POINT_CHUNK, cloud.count - first);
+                    int* offsets = &counts[(size_t)c * numTiles];
+                    for(int i = first; i < first + count; i++)
+                    {
+                        const PointSplat & splat = projected[i];
+                        if(splat.depth == 0)
+                        {
+                            continue;
+                        }
+                        int tx0, ty0, tx1, ty1;
+                        splatTiles(splat, bounds, size, tx0, ty0, tx1, ty1);
+                        for(int ty = ty0; ty <= ty1; ty++)
+                        {
+                            for(int tx = tx0; tx <= tx1; tx++)
+                            {
+                                binned[offsets[ty * across + tx]++] = splat;
+                            }
+                        }
+                    }
+                });
+            }
+
+            // Splat, one thread per tile
+            StageTimer timer(STAGE_RASTER);
+            tiles.runTiles(activeTiles, zBuf, [&](int b, const ScreenRect & rect)
+            {
+                ScreenRect clip = IntersectRects(rect, bounds);
+                uint64_t generated = 0;
+                uint64_t depthRejected = 0;
+                for(int s = tileStart[b]; s < tileStart[b + 1]; s++)
+                {
+                    const PointSplat & splat = binned[s];
+                    int x0 = std::max((int)splat.x, clip.x0);
+                    int y0 = std::max((int)splat.y, clip.y0);
+                    int x1 = std::min(splat.x + size, clip.x1);
+                    int y1 = std::min(splat.y + size, clip.y1);
+                    generated += (uint64_t)(x1 - x0) * (y1 - y0);
+                    for(int y = y0; y < y1; y++)
+                    {
+                        PIXEL* row = target[y];
+                        float* zRow = zBuf != NULL ? (*zBuf)[y] : NULL;
+                        for(int x = x0; x < x1; x++)
+                        {
+                            if(zRow != NULL)
+                            {
+                                if(splat.depth <= zRow[x])
+                                {
+                                    depthRejected++;
+                                    continue;
+                                }
+                                zRow[x] = splat.depth;
+                                float & coarseNear = zBuf->blockNear(x, y);
+                                coarseNear = splat.depth > coarseNear ? splat.depth : coarseNear;
+                            }
+                            row[x] = splat.color;
+                        }
+                    }
+                }
+                PIPELINE_STAT(fragmentsGenerated, generated);
+                PIPELINE_STAT(fragmentsDepthRejected, depthRejected);
+                PIPELINE_STAT(fragmentsShaded, generated - depthRejected);
+            });
+        }
+};
+
+inline PointRenderer & GetPointRenderer()
+{
+    static PointRenderer points;
+    return points;
+}
+
+#endif
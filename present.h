@@ -0,0 +1,157 @@
+#include "definitions.h"
+#include "tiles.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+#ifndef PRESENT_H
+#define PRESENT_H
+
+// Frames in flight between the renderer and the display
+#define MIN_PRESENT_FRAMES 2
+#define MAX_PRESENT_FRAMES 3
+
+/******************************************************
+ * FRAME_PRESENTER:
+ * Owns a small ring of frame buffers and a present
+ * thread. The caller draws into 'frame()' and hands it
+ * over with 'present()'; the present thread uploads it
+ * into a streaming texture and presents it while the
+ * next frame is being rendered.
+ *
+ * Uploads write straight into the locked texture, one
+ * row copy per scanline (frames are bottom-up, the
+ * texture is top-down). A buffer is returned to the
+ * ring as soon as it is uploaded, before the present
+ * itself, so rendering only waits when every buffer is
+ * still queued.
+ *
+ * After construction the renderer belongs to the
+ * present thread; the caller must not use it until
+ * the presenter is destroyed.
+ *****************************************************/
+class FramePresenter
+{
+    private:
+        SDL_Renderer* ren;
+        SDL_Texture* texture;
+        std::vector<Buffer2D<PIXEL>*> frames;
+        std::vector<bool> busy;         // Queued or uploading
+        std::deque<int> queued;         // Frames waiting for the present thread
+        int drawing;                    // Frame handed out by 'frame()'
+
+        std::thread worker;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable freed;
+        bool quit;
+
+        // Copy frame 'idx' into the streaming texture
+        void upload(const int & idx)
+        {
+            const Buffer2D<PIXEL> & src = *frames[idx];
+            void* pixels;
+            int pitch;
+            if(SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0)
+            {
+                return;
+            }
+            size_t rowBytes = sizeof(PIXEL) * src.width();
+            for(int y = 0; y < src.height(); y++)
+            {
+                memcpy((char*)pixels + (size_t)pitch * y, src[src.height() - 1 - y], rowBytes);
+            }
+            SDL_UnlockTexture(texture);
+        }
+
+        // Present thread body
+        void presentLoop()
+        {
+            while(true)
+            {
+                int idx;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    wake.wait(guard, [&]{ return quit || !queued.empty(); });
+                    if(queued.empty())
+                    {
+                        return;
+                    }
+                    idx = queued.front();
+                    queued.pop_front();
+                }
+
+                upload(idx);
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    busy[idx] = false;
+                }
+                freed.notify_one();
+
+                SDL_RenderClear(ren);
+                SDL_RenderCopy(ren, texture, NULL, NULL);
+                SDL_RenderPresent(ren);
+            }
+        }
+
+        // Non-copyable
+        FramePresenter(const FramePresenter &);
+        FramePresenter& operator=(const FramePresenter &);
+
+    public:
+        FramePresenter(SDL_Renderer* renderer, int width, int height, int count = MIN_PRESENT_FRAMES) : ren(renderer), drawing(0), quit(false)
+        {
+            count = count < MIN_PRESENT_FRAMES ? MIN_PRESENT_FRAMES : (count > MAX_PRESENT_FRAMES ? MAX_PRESENT_FRAMES : count);
+            texture = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+            for(int i = 0; i < count; i++)
+            {
+                frames.push_back(new Buffer2D<PIXEL>(width, height));
+                busy.push_back(false);
+            }
+            busy[drawing] = true;
+            worker = std::thread(&FramePresenter::presentLoop, this);
+        }
+
+        // Presents every queued frame, then releases the ring and texture
+        ~FramePresenter()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                quit = true;
+            }
+            wake.notify_one();
+            worker.join();
+
+            for(size_t i = 0; i < frames.size(); i++)
+            {
+                delete frames[i];
+            }
+            SDL_DestroyTexture(texture);
+        }
+
+        // Frame to draw into until the next 'present'
+        Buffer2D<PIXEL> & frame()
+        {
+            return *frames[drawing];
+        }
+
+        // Finishes the current frame, queues it for display and
+        // switches to the next free buffer
+        void present()
+        {
+            GetTileRenderer().finishFrame();
+
+            std::unique_lock<std::mutex> guard(lock);
+            queued.push_back(drawing);
+            wake.notify_one();
+
+            int next = (drawing + 1) % (int)frames.size();
+            freed.wait(guard, [&]{ return !busy[next]; });
+            busy[next] = true;
+            drawing = next;
+        }
+};
+
+#endif
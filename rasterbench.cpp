@@ -0,0 +1,61 @@
+/*************************************************************
+ * RASTER_BENCH:
+ * Microbenchmark for the half-space coverage kernels. Draws
+ * the triangle set from SceneTriangle repeatedly with the
+ * scalar and SIMD kernels on one thread, checks that both 
+ * produce the same frame and reports the time per frame.
+ *
+ * Build:  g++ -O2 -std=c++11 rasterbench.cpp -lSDL2 -pthread
+ * Usage:  ./a.out [frames]
+ ************************************************************/
+#define PIPELINE_NO_MAIN
+#include "pipeline.cpp"
+#include "scenes.h"
+#include <chrono>
+
+/*************************************************************
+ * Renders 'frames' frames with the active kernel, returns
+ * the average milliseconds per frame.
+ ************************************************************/
+double TimeKernel(Buffer2D<PIXEL> & frame, const int & frames)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int i = 0; i < frames; i++)
+    {
+        clearScreen(frame);
+        SceneTriangle(frame);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 2000;
+    Buffer2D<PIXEL> scalarFrame(S_WIDTH, S_HEIGHT);
+    Buffer2D<PIXEL> simdFrame(S_WIDTH, S_HEIGHT);
+    SetRasterThreads(1);
+
+    SetRasterKernel(RASTER_SCALAR);
+    double scalarMs = TimeKernel(scalarFrame, frames);
+    printf("scalar: %8.4f ms/frame\n", scalarMs);
+
+    if(!SetRasterKernel(RASTER_SSE2))
+    {
+        printf("sse2:   not available in this build\n");
+        return 0;
+    }
+    double simdMs = TimeKernel(simdFrame, frames);
+    printf("sse2:   %8.4f ms/frame (%.2fx)\n", simdMs, scalarMs / simdMs);
+
+    for(int y = 0; y < S_HEIGHT; y++)
+    {
+        if(memcmp(scalarFrame[y], simdFrame[y], sizeof(PIXEL) * S_WIDTH) != 0)
+        {
+            printf("MISMATCH: kernels disagree on row %d\n", y);
+            return 1;
+        }
+    }
+    printf("frames match\n");
+    return 0;
+}
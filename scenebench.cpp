@@ -0,0 +1,356 @@
+/*************************************************************
+ * SCENEBENCH:
+ * Golden-image regression test and benchmark for the test
+ * scenes. Each scene is rendered offscreen and compared
+ * against its reference image in golden/, then timed over
+ * a number of repetitions after a few warmup frames.
+ * Results, per-scene pass/fail and timing statistics, are
+ * written as JSON; the exit status is nonzero if any scene
+ * does not match its reference.
+ *
+ * Build:  g++ -O2 -std=c++11 scenebench.cpp -lSDL2 -pthread
+ * Usage:  ./a.out [scene ...] [--threads N] [--warmup N]
+ *                 [--reps N] [--tolerance N] [--max-bad F]
+ *                 [--golden dir] [--json results.json]
+ *                 [--update]
+ * Scenes: pixel, triangle, fragments, perspective,
+ *         vertexshader, pipeline, elements, replay 
+ *         (all by default)
+ *
+ * Run from the repository root, the scenes load their
+ * images by relative path. A pixel differs when any of its
+ * color channels is off by more than --tolerance (2); a
+ * scene passes while at most --max-bad (0.001) of its
+ * covered pixels differ, those off the background color
+ * in either image. --update rewrites the references from
+ * the current renders instead of comparing. Scenes with a
+ * reference scene (replay) are instead compared against
+ * its render and must match it exactly.
+ ************************************************************/
+#define PIPELINE_NO_MAIN
+#include "pipeline.cpp"
+#include "bmpio.h"
+#include "scenes.h"
+#include <chrono>
+#include <algorithm>
+#include <string>
+
+/*************************************************************
+ * Scene table.
+ ************************************************************/
+struct BenchScene
+{
+    const char* name;
+    void (*draw)(Buffer2D<PIXEL> & target);
+    void (*reference)(Buffer2D<PIXEL> & target);  // Render to match instead of a golden image, if any
+};
+
+static const BenchScene SCENES[] =
+{
+    { "pixel",        ScenePixel,        NULL },
+    { "triangle",     SceneTriangle,     NULL },
+    { "fragments",    SceneFragments,    NULL },
+    { "perspective",  ScenePerspective,  NULL },
+    { "vertexshader", SceneVertexShader, NULL },
+    { "pipeline",     ScenePipeline,     NULL },
+    { "elements",     SceneElements,     NULL },
+    { "replay",       SceneReplay,       SceneElements }
+};
+static const int NUM_SCENES = sizeof(SCENES) / sizeof(SCENES[0]);
+
+// clearScreen's default, what uncovered pixels hold
+static const PIXEL BACKGROUND = 0xff000000;
+
+void PrintUsage()
+{
+    printf("usage: scenebench [scene ...] [--threads N] [--warmup N] [--reps N] [--tolerance N]\n");
+    printf("                  [--max-bad F] [--golden dir] [--json file] [--update]\n");
+    printf("scenes:");
+    for(int i = 0; i < NUM_SCENES; i++)
+    {
+        printf(" %s", SCENES[i].name);
+    }
+    printf("\n");
+}
+
+/*************************************************************
+ * Value at fraction 'q' of an ascending sample list.
+ ************************************************************/
+double Percentile(const std::vector<double> & sorted, const double & q)
+{
+    size_t idx = (size_t)ceil(q * sorted.size());
+    idx = idx == 0 ? 0 : idx - 1;
+    return sorted[idx < sorted.size() ? idx : sorted.size() - 1];
+}
+
+/*************************************************************
+ * Comparison of a render against its reference. Only the
+ * color channels count, references carry no alpha. Pixels
+ * left at the background in both images are not covered,
+ * the bad fraction is taken over the covered ones so a
+ * sparse scene cannot lose its content within tolerance.
+ ************************************************************/
+struct ImageDiff
+{
+    bool loaded;
+    bool sizeMatches;
+    int maxChannelDiff;
+    long badPixels;
+    long coveredPixels;
+    long totalPixels;
+};
+
+ImageDiff CompareImages(const Buffer2D<PIXEL> & image, const Buffer2D<PIXEL>* reference, const int & tolerance,
+                        const PIXEL & background)
+{
+    ImageDiff diff = { reference != NULL, false, 0, 0, 0, (long)image.width() * image.height() };
+    if(reference == NULL || reference->width() != image.width() || reference->height() != image.height())
+    {
+        return diff;
+    }
+
+    diff.sizeMatches = true;
+    for(int y = 0; y < image.height(); y++)
+    {
+        const PIXEL* row = image[y];
+        const PIXEL* refRow = (*reference)[y];
+        for(int x = 0; x < image.width(); x++)
+        {
+            int worst = 0;
+            for(int shift = 0; shift < 24; shift += 8)
+            {
+                int d = ABS((int)((row[x] >> shift) & 0xff) - (int)((refRow[x] >> shift) & 0xff));
+                worst = d > worst ? d : worst;
+            }
+            diff.maxChannelDiff = worst > diff.maxChannelDiff ? worst : diff.maxChannelDiff;
+            diff.badPixels += worst > tolerance ? 1 : 0;
+            diff.coveredPixels += ((row[x] ^ background) & 0xffffff) != 0 || ((refRow[x] ^ background) & 0xffffff) != 0 ? 1 : 0;
+        }
+    }
+    return diff;
+}
+
+/*************************************************************
+ * Results of one scene.
+ ************************************************************/
+struct SceneResult
+{
+    const char* name;
+    ImageDiff diff;
+    bool passed;
+    double meanMs;
+    double stddevMs;
+    double minMs;
+    double medianMs;
+    double p99Ms;
+    double maxMs;
+};
+
+SceneResult RunScene(const BenchScene & scene, Buffer2D<PIXEL> & frame, const std::string & goldenDir,
+                     const int & warmup, const int & reps, const int & tolerance, const double & maxBad, const bool & update)
+{
+    SceneResult result = {};
+    result.name = scene.name;
+    std::string goldenPath = goldenDir + "/" + scene.name + ".bmp";
+
+    // The reference check uses the first frame, the warmup the rest
+    for(int f = 0; f < 1 + warmup; f++)
+    {
+        clearScreen(frame, BACKGROUND);
+        scene.draw(frame);
+        FinishFrame();
+        if(f == 0 && scene.reference != NULL)
+        {
+            Buffer2D<PIXEL> reference(frame.width(), frame.height());
+            clearScreen(reference, BACKGROUND);
+            scene.reference(reference);
+            FinishFrame();
+            result.diff = CompareImages(frame, &reference, 0, BACKGROUND);
+            result.passed = result.diff.sizeMatches && result.diff.badPixels == 0;
+        }
+        else if(f == 0)
+        {
+            if(update && !SaveBMP(frame, goldenPath.c_str(), 24))
+            {
+                printf("could not write %s\n", goldenPath.c_str());
+            }
+            Buffer2D<PIXEL>* reference = LoadBMP(goldenPath.c_str());
+            result.diff = CompareImages(frame, reference, tolerance, BACKGROUND);
+            result.passed = result.diff.sizeMatches && result.diff.badPixels <= maxBad * result.diff.coveredPixels;
+            delete reference;
+        }
+    }
+
+    std::vector<double> frameMs;
+    frameMs.reserve(reps);
+    for(int f = 0; f < reps; f++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        clearScreen(frame, BACKGROUND);
+        scene.draw(frame);
+        FinishFrame();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    double total = 0;
+    for(int f = 0; f < reps; f++)
+    {
+        total += frameMs[f];
+    }
+    result.meanMs = total / reps;
+    double squares = 0;
+    for(int f = 0; f < reps; f++)
+    {
+        squares += (frameMs[f] - result.meanMs) * (frameMs[f] - result.meanMs);
+    }
+    result.stddevMs = reps > 1 ? sqrt(squares / (reps - 1)) : 0;
+
+    std::sort(frameMs.begin(), frameMs.end());
+    result.minMs = frameMs.front();
+    result.medianMs = Percentile(frameMs, 0.50);
+    result.p99Ms = Percentile(frameMs, 0.99);
+    result.maxMs = frameMs.back();
+    return result;
+}
+
+/*************************************************************
+ * JSON report of a whole run.
+ ************************************************************/
+void WriteJSON(FILE* out, const std::vector<SceneResult> & results, const int & threads, const int & warmup,
+               const int & reps, const int & tolerance, const double & maxBad)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"width\": %d,\n  \"height\": %d,\n", S_WIDTH, S_HEIGHT);
+    fprintf(out, "  \"threads\": %d,\n  \"warmup\": %d,\n  \"reps\": %d,\n", threads, warmup, reps);
+    fprintf(out, "  \"tolerance\": %d,\n  \"max_bad_fraction\": %g,\n", tolerance, maxBad);
+    fprintf(out, "  \"scenes\": [\n");
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const SceneResult & r = results[i];
+        fprintf(out, "    {\n");
+        fprintf(out, "      \"name\": \"%s\",\n", r.name);
+        fprintf(out, "      \"passed\": %s,\n", r.passed ? "true" : "false");
+        fprintf(out, "      \"reference_found\": %s,\n", r.diff.loaded ? "true" : "false");
+        fprintf(out, "      \"max_channel_diff\": %d,\n", r.diff.maxChannelDiff);
+        fprintf(out, "      \"bad_pixels\": %ld,\n", r.diff.badPixels);
+        fprintf(out, "      \"covered_pixels\": %ld,\n", r.diff.coveredPixels);
+        fprintf(out, "      \"total_pixels\": %ld,\n", r.diff.totalPixels);
+        fprintf(out, "      \"mean_ms\": %.4f,\n", r.meanMs);
+        fprintf(out, "      \"stddev_ms\": %.4f,\n", r.stddevMs);
+        fprintf(out, "      \"min_ms\": %.4f,\n", r.minMs);
+        fprintf(out, "      \"median_ms\": %.4f,\n", r.medianMs);
+        fprintf(out, "      \"p99_ms\": %.4f,\n", r.p99Ms);
+        fprintf(out, "      \"max_ms\": %.4f\n", r.maxMs);
+        fprintf(out, "    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<const BenchScene*> selected;
+    int threads = std::thread::hardware_concurrency();
+    int warmup = 5;
+    int reps = 50;
+    int tolerance = 2;
+    double maxBad = 0.001;
+    std::string goldenDir = "golden";
+    const char* jsonPath = NULL;
+    bool update = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--threads" && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if(arg == "--warmup" && i + 1 < argc)
+        {
+            warmup = atoi(argv[++i]);
+        }
+        else if(arg == "--reps" && i + 1 < argc)
+        {
+            reps = atoi(argv[++i]);
+        }
+        else if(arg == "--tolerance" && i + 1 < argc)
+        {
+            tolerance = atoi(argv[++i]);
+        }
+        else if(arg == "--max-bad" && i + 1 < argc)
+        {
+            maxBad = atof(argv[++i]);
+        }
+        else if(arg == "--golden" && i + 1 < argc)
+        {
+            goldenDir = argv[++i];
+        }
+        else if(arg == "--json" && i + 1 < argc)
+        {
+            jsonPath = argv[++i];
+        }
+        else if(arg == "--update")
+        {
+            update = true;
+        }
+        else
+        {
+            const BenchScene* scene = NULL;
+            for(int s = 0; s < NUM_SCENES; s++)
+            {
+                if(arg == SCENES[s].name)
+                {
+                    scene = &SCENES[s];
+                }
+            }
+            if(scene == NULL)
+            {
+                PrintUsage();
+                return 1;
+            }
+            selected.push_back(scene);
+        }
+    }
+    if(reps <= 0 || warmup < 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+    if(selected.empty())
+    {
+        for(int s = 0; s < NUM_SCENES; s++)
+        {
+            selected.push_back(&SCENES[s]);
+        }
+    }
+
+    threads = threads < 1 ? 1 : threads;
+    Buffer2D<PIXEL> frame(S_WIDTH, S_HEIGHT);
+    SetRasterThreads(threads);
+    SetLazyClear(true);
+
+    std::vector<SceneResult> results;
+    bool allPassed = true;
+    for(size_t i = 0; i < selected.size(); i++)
+    {
+        SceneResult r = RunScene(*selected[i], frame, goldenDir, warmup, reps, tolerance, maxBad, update);
+        allPassed = allPassed && r.passed;
+        results.push_back(r);
+        fprintf(stderr, "%-13s %s  diff %ld/%ld px (max %d)  mean %.3f ms  sd %.3f  p99 %.3f\n", r.name,
+                r.passed ? "ok  " : (r.diff.loaded ? "FAIL" : "MISS"), r.diff.badPixels, r.diff.coveredPixels,
+                r.diff.maxChannelDiff, r.meanMs, r.stddevMs, r.p99Ms);
+    }
+
+    FILE* out = jsonPath != NULL ? fopen(jsonPath, "w") : stdout;
+    if(out == NULL)
+    {
+        printf("could not write %s\n", jsonPath);
+        return 1;
+    }
+    WriteJSON(out, results, threads, warmup, reps, tolerance, maxBad);
+    if(out != stdout)
+    {
+        fclose(out);
+    }
+    return allPassed ? 0 : 1;
+}
@@ -0,0 +1,373 @@
+#include "definitions.h"
+#include "assets.h"
+#include "matrix.h"
+#include "commandbuffer.h"
+
+#ifndef SCENES_H
+#define SCENES_H
+
+/******************************************************
+ * SCENES:
+ * Worked versions of the course test scenes, with
+ * their attributes, uniforms and shaders filled in.
+ * The offscreen drivers render these so there is
+ * something to time and compare; coursefunctions.h
+ * keeps the exercise skeletons for the projects.
+ *****************************************************/
+
+// Unpacks 'color' into r, g, b slots in [0, 1]
+inline void SetColorAttributes(Attributes & attr, const PIXEL & color)
+{
+    attr[0] = ((color >> 16) & 0xff) / 255.0f;
+    attr[1] = ((color >> 8) & 0xff) / 255.0f;
+    attr[2] = (color & 0xff) / 255.0f;
+    attr.numMembers = 3;
+}
+
+// Stores a (u, v) texture coordinate pair in the first two slots
+inline void SetTexCoordAttributes(Attributes & attr, const double coord[2])
+{
+    attr[0] = (float)coord[0];
+    attr[1] = (float)coord[1];
+    attr.numMembers = 2;
+}
+
+// Packs the interpolated r, g, b slots back into a pixel
+inline void ColorFragShader(PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms)
+{
+    PIXEL color = 0xff000000;
+    for(int c = 0; c < 3; c++)
+    {
+        float v = vertAttr[c] < 0 ? 0 : (vertAttr[c] > 1 ? 1 : vertAttr[c]);
+        color |= (PIXEL)(v * 255 + 0.5f) << (16 - 8 * c);
+    }
+    fragment = color;
+}
+
+// Nearest texel of the uniforms' image (BufferImage or cached asset) at the (u, v) slots
+inline void ImageFragShader(PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms)
+{
+    const Buffer2D<PIXEL>* img = (const Buffer2D<PIXEL>*)uniforms.ptrImg;
+    int x = (int)(vertAttr[0] * (img->width() - 1));
+    int y = (int)(vertAttr[1] * (img->height() - 1));
+    x = x < 0 ? 0 : (x >= img->width() ? img->width() - 1 : x);
+    y = y < 0 ? 0 : (y >= img->height() ? img->height() - 1 : y);
+    fragment = (*img)[y][x];
+}
+
+// Filtered, mipmapped lookup of the uniforms' Texture at the (u, v) slots
+inline void TextureFragShader(PIXEL & fragment, const Attributes & vertAttr, const Attributes & uniforms)
+{
+    const Texture* tex = (const Texture*)uniforms.ptrImg;
+    fragment = tex->sample(vertAttr, 0);
+}
+
+/******************************************************
+ * A lattice of single points shaded by their color 
+ * attributes, TestDrawPixel.
+ *****************************************************/
+inline void ScenePixel(Buffer2D<PIXEL> & target)
+{
+    Attributes uniforms;
+    FragmentShader frag(ColorFragShader);
+    for(int y = 8; y < target.height(); y += 16)
+    {
+        for(int x = 8; x < target.width(); x += 16)
+        {
+            Vertex vert = {(double)x, (double)y, 1, 1};
+            Attributes attr;
+            PIXEL color = 0xff000000 | ((x * 255 / target.width()) << 16) | ((y * 255 / target.height()) << 8) | 0x80;
+            SetColorAttributes(attr, color);
+            DrawPrimitive(POINT, target, &vert, &attr, &uniforms, &frag);
+        }
+    }
+}
+
+/******************************************************
+ * Six flat color triangles, TestDrawTriangle.
+ *****************************************************/
+inline void SceneTriangle(Buffer2D<PIXEL> & target)
+{
+    static const Vertex verts[6][3] =
+    {
+        {{100, 362, 1, 1}, {150, 452, 1, 1}, {50, 452, 1, 1}},
+        {{300, 402, 1, 1}, {250, 452, 1, 1}, {250, 362, 1, 1}},
+        {{450, 362, 1, 1}, {450, 452, 1, 1}, {350, 402, 1, 1}},
+        {{110, 262, 1, 1}, {60, 162, 1, 1}, {150, 162, 1, 1}},
+        {{210, 252, 1, 1}, {260, 172, 1, 1}, {310, 202, 1, 1}},
+        {{370, 202, 1, 1}, {430, 162, 1, 1}, {470, 252, 1, 1}}
+    };
+    static const PIXEL colors[6] = {0xffff0000, 0xffff0000, 0xff00ff00, 0xff00ff00, 0xff00ff00, 0xff00ff00};
+
+    Vertex tri[3];
+    Attributes attr[3];
+    Attributes uniforms;
+    FragmentShader frag(ColorFragShader);
+    for(int t = 0; t < 6; t++)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            tri[i] = verts[t][i];
+            SetColorAttributes(attr[i], colors[t]);
+        }
+        DrawPrimitive(TRIANGLE, target, tri, attr, &uniforms, &frag);
+    }
+}
+
+/******************************************************
+ * Interpolated color and image triangles, 
+ * TestDrawFragments.
+ *****************************************************/
+inline void SceneFragments(Buffer2D<PIXEL> & target)
+{
+    // 1. Interpolated color triangle
+    Vertex colorTriangle[3] = {{250, 112, 1, 1}, {450, 452, 1, 1}, {50, 452, 1, 1}};
+    Attributes colorAttributes[3];
+    PIXEL colors[3] = {0xffff0000, 0xff00ff00, 0xff0000ff};
+    for(int i = 0; i < 3; i++)
+    {
+        SetColorAttributes(colorAttributes[i], colors[i]);
+    }
+    Attributes colorUniforms;
+    FragmentShader colorFrag(ColorFragShader);
+    DrawPrimitive(TRIANGLE, target, colorTriangle, colorAttributes, &colorUniforms, &colorFrag);
+
+    // 2. Interpolated image triangle, the cache keeps the image alive for queued triangles
+    Vertex imageTriangle[3] = {{425, 112, 1, 1}, {500, 252, 1, 1}, {350, 252, 1, 1}};
+    Attributes imageAttributes[3];
+    double coordinates[3][2] = { {1,0}, {1,1}, {0,1} };
+    for(int i = 0; i < 3; i++)
+    {
+        SetTexCoordAttributes(imageAttributes[i], coordinates[i]);
+    }
+    std::shared_ptr<const Buffer2D<PIXEL> > image = GetAssetCache().image("image.bmp");
+    Attributes imageUniforms;
+    imageUniforms.insertPtr(image.get());
+    FragmentShader imageFrag(ImageFragShader);
+    DrawPrimitive(TRIANGLE, target, imageTriangle, imageAttributes, &imageUniforms, &imageFrag);
+}
+
+/******************************************************
+ * Perspective correct, mipmapped checker quad,
+ * TestDrawPerspectiveCorrect.
+ *****************************************************/
+inline void ScenePerspective(Buffer2D<PIXEL> & target)
+{
+    // Artificially projected, viewport transformed
+    double divA = 6;
+    double divB = 40;
+    Vertex quad[] = {{(-1200 / divA) + (S_WIDTH/2), (-1500 / divA) + (S_HEIGHT/2), divA, 1.0/divA },
+                     {(1200  / divA) + (S_WIDTH/2), (-1500 / divA) + (S_HEIGHT/2), divA, 1.0/divA },
+                     {(1200  / divB) + (S_WIDTH/2), (1500  / divB) + (S_HEIGHT/2), divB, 1.0/divB },
+                     {(-1200 / divB) + (S_WIDTH/2), (1500  / divB) + (S_HEIGHT/2), divB, 1.0/divB }};
+
+    // Coordinates are already divided by depth, like the vertices
+    double coordinates[4][2] = { {0/divA,0/divA}, {1/divA,0/divA}, {1/divB,1/divB}, {0/divB,1/divB} };
+    int corners[2][3] = {{0, 1, 2}, {2, 3, 0}};
+
+    std::shared_ptr<const Texture> texture = GetAssetCache().texture("checker.bmp", WRAP_CLAMP);
+    Attributes uniforms;
+    uniforms.insertPtr(texture.get());
+    FragmentShader frag(TextureFragShader);
+
+    Vertex tri[3];
+    Attributes attr[3];
+    for(int t = 0; t < 2; t++)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            tri[i] = quad[corners[t][i]];
+            SetTexCoordAttributes(attr[i], coordinates[corners[t][i]]);
+        }
+        DrawPrimitive(TRIANGLE, target, tri, attr, &uniforms, &frag);
+    }
+}
+
+// Position times the Matrix in the uniforms' pointer slot, attributes passed through
+inline void MatrixUniformVertShader(Vertex & vertOut, Attributes & attrOut, const Vertex & vertIn, const Attributes & vertAttr,
+                                    const Attributes & uniforms)
+{
+    TransformVertices(*(const Matrix*)uniforms.ptrImg, &vertIn, &vertOut, 1);
+    attrOut = vertAttr;
+}
+
+/******************************************************
+ * One interpolated color triangle moved by a vertex 
+ * shader: translated, scaled, rotated 45 degrees about
+ * the origin, then all three (scale first), 
+ * TestVertexShader.
+ *****************************************************/
+inline void SceneVertexShader(Buffer2D<PIXEL> & target)
+{
+    Vertex colorTriangle[3] = {{350, 112, 1, 1}, {400, 200, 1, 1}, {300, 200, 1, 1}};
+    Attributes colorAttributes[3];
+    PIXEL colors[3] = {0xffff0000, 0xff00ff00, 0xff0000ff};
+    for(int i = 0; i < 3; i++)
+    {
+        SetColorAttributes(colorAttributes[i], colors[i]);
+    }
+    FragmentShader frag(ColorFragShader);
+    VertexShader vert(MatrixUniformVertShader);
+
+    Matrix translate = Matrix::translate(100, 50, 0);
+    Matrix scale = Matrix::scale(0.5, 0.5, 1);
+    Matrix rotate = Matrix::rotateZ(atan(1.0));       // 45 degrees
+    Matrix transforms[4] = {translate, scale, rotate, rotate * translate * scale};
+    for(int t = 0; t < 4; t++)
+    {
+        Attributes uniforms;
+        uniforms.insertPtr(&transforms[t]);
+        DrawPrimitive(TRIANGLE, target, colorTriangle, colorAttributes, &uniforms, &frag, &vert);
+    }
+}
+
+/******************************************************
+ * Projected, clipped and depth tested geometry, 
+ * TestPipeline: a tiled checker floor running past 
+ * the camera through the near plane and an image quad 
+ * standing in it, so the floor hides its lower part.
+ *****************************************************/
+inline void ScenePipeline(Buffer2D<PIXEL> & target)
+{
+    // Kept across frames, replaced when the target changes size. Work
+    // still queued for the old buffer is drawn before it goes.
+    static std::unique_ptr<DepthBuffer> depth;
+    if(!depth || depth->width() != target.width() || depth->height() != target.height())
+    {
+        FinishFrame();
+        depth.reset(new DepthBuffer(target.width(), target.height()));
+    }
+    DepthBuffer & zBuf = *depth;
+    ClearDepth(zBuf);
+
+    Vertex verts[] = {{-4, -1,   1, 1}, {4, -1,   1, 1}, {4, -1, -14, 1}, {-4, -1, -14, 1},
+                      {-2, -2, -6, 1}, {1, -2, -5, 1}, {1,  1.5, -5, 1}, {-2,  1.5, -6, 1}};
+    double coordinates[8][2] = { {0,0}, {4,0}, {4,8}, {0,8},
+                                 {0,0}, {1,0}, {1,1}, {0,1} };
+    Attributes attrs[8];
+    for(int i = 0; i < 8; i++)
+    {
+        SetTexCoordAttributes(attrs[i], coordinates[i]);
+    }
+    unsigned int floorIndices[] = {0, 1, 2, 2, 3, 0};
+    unsigned int imageIndices[] = {4, 5, 6, 6, 7, 4};
+
+    Matrix mvp = Matrix::perspective(1.0, (double)target.width() / target.height(), 0.1, 100) * 
+                 Matrix::rotateX(0.15) * Matrix::rotateY(-0.2);
+
+    std::shared_ptr<const Texture> checker = GetAssetCache().texture("checker.bmp", WRAP_REPEAT);
+    std::shared_ptr<const Texture> image = GetAssetCache().texture("image.bmp", WRAP_CLAMP);
+    Attributes floorUniforms;
+    floorUniforms.insertPtr(checker.get());
+    Attributes imageUniforms;
+    imageUniforms.insertPtr(image.get());
+
+    SetClipping(true);
+    DrawElementsWith(TRIANGLE, target, verts, attrs, floorIndices, 6, &floorUniforms,
+                     StaticFragShader<TextureFragShader>(), MatrixVertShader(&mvp), &zBuf);
+    DrawElementsWith(TRIANGLE, target, verts, attrs, imageIndices, 6, &imageUniforms,
+                     StaticFragShader<TextureFragShader>(), MatrixVertShader(&mvp), &zBuf);
+    SetClipping(false);
+}
+
+/******************************************************
+ * Indexed draws of the replay scenes: one draw through
+ * DrawElements, or recorded into 'record' when given.
+ * NULL 'idx' draws the vertices in order.
+ *****************************************************/
+inline void SceneElementsDraw(Buffer2D<PIXEL> & target, CommandBuffer* record, FragmentShader* frag, PRIMITIVES prim,
+                              const Vertex* verts, const Attributes* attrs, const int & numVerts,
+                              const unsigned int* idx, const int & count)
+{
+    if(record == NULL)
+    {
+        Attributes uniforms;
+        DrawElements(prim, target, verts, attrs, idx, count, &uniforms, frag);
+        return;
+    }
+    record->setFragmentShader(frag);
+    if(idx == NULL)
+    {
+        record->draw(prim, verts, attrs, count);
+    }
+    else
+    {
+        record->drawElements(prim, verts, attrs, numVerts, idx, count);
+    }
+}
+
+// Every draw of the replay scenes, in order
+inline void SceneElementsDraws(Buffer2D<PIXEL> & target, CommandBuffer* record)
+{
+    const unsigned int R = PRIMITIVE_RESTART;
+
+    // A 4 x 2 vertex strip per row, three quads, colored corner to corner
+    Vertex verts[5][8];
+    Attributes attrs[8];
+    for(int row = 0; row < 5; row++)
+    {
+        for(int i = 0; i < 8; i++)
+        {
+            Vertex v = {60.0 + 130 * (i % 4), 30.0 + 95 * row + 70 * (i / 4), 1, 1};
+            verts[row][i] = v;
+        }
+    }
+    for(int i = 0; i < 8; i++)
+    {
+        SetColorAttributes(attrs[i], 0xff000000 | ((i % 4) * 80 << 16) | ((i / 4) * 255 << 8) | (255 - (i % 4) * 80));
+    }
+    // Recorded draws reference their shaders until replayed
+    static FragmentShader color(ColorFragShader);
+    static FragmentShader flat(DefaultFragShader);
+
+    // Restart inside the list, which does not end on a whole triangle
+    unsigned int restarted[] = {0, 1, 5, R, 5, 4, 0, 1, 2, 6};
+    SceneElementsDraw(target, record, &color, TRIANGLE, verts[0], attrs, 8, restarted, 10);
+
+    // Two mergeable draws, the first leaving a partial triangle
+    unsigned int partial[] = {0, 1, 5, R, 5, 4};
+    unsigned int rest[] = {5, 4, 0, 1, 2, 6, 2, 3, 7};
+    SceneElementsDraw(target, record, &color, TRIANGLE, verts[1], attrs, 8, partial, 6);
+    SceneElementsDraw(target, record, &color, TRIANGLE, verts[1], attrs, 8, rest, 9);
+
+    // Other state, unindexed with a vertex to spare
+    Vertex loose[7] = {verts[2][0], verts[2][1], verts[2][5], verts[2][2], verts[2][3], verts[2][7], verts[2][6]};
+    SceneElementsDraw(target, record, &flat, TRIANGLE, loose, attrs, 7, NULL, 7);
+
+    // Line lists, merged, with restarts and a spare index
+    unsigned int lines[] = {0, 1, R, 1, 2, 3};
+    unsigned int moreLines[] = {4, 5, 5, 6, R, 6, 7, 3, 7};
+    SceneElementsDraw(target, record, &color, LINE, verts[3], attrs, 8, lines, 6);
+    SceneElementsDraw(target, record, &color, LINE, verts[3], attrs, 8, moreLines, 9);
+
+    // Leading and repeated restarts, and a draw of nothing but restarts
+    unsigned int leading[] = {R, 0, 1, 5, R, R, 2, 3, 7};
+    unsigned int empty[] = {R, R, R};
+    unsigned int last[] = {6, 7, 2};
+    SceneElementsDraw(target, record, &color, TRIANGLE, verts[4], attrs, 8, leading, 9);
+    SceneElementsDraw(target, record, &color, TRIANGLE, verts[4], attrs, 8, empty, 3);
+    SceneElementsDraw(target, record, &color, TRIANGLE, verts[4], attrs, 8, last, 3);
+}
+
+/******************************************************
+ * Index lists with restarts, partial primitives and 
+ * state changes, drawn immediately.
+ *****************************************************/
+inline void SceneElements(Buffer2D<PIXEL> & target)
+{
+    SceneElementsDraws(target, NULL);
+}
+
+/******************************************************
+ * The same draws recorded into a command buffer, which
+ * merges them into batches, and replayed. Must match
+ * SceneElements pixel for pixel.
+ *****************************************************/
+inline void SceneReplay(Buffer2D<PIXEL> & target)
+{
+    CommandBuffer commands;
+    SceneElementsDraws(target, &commands);
+    commands.submit(target);
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "definitions.h"
+#include <atomic>
+#include <chrono>
+
+#ifndef STATS_H
+#define STATS_H
+
+/******************************************************
+ * Pipeline stages that record cumulative time.
+ *****************************************************/
+enum PIPELINE_STAGES
+{
+    STAGE_VERTEX,
+    STAGE_CLIP,
+    STAGE_NORMALIZE,
+    STAGE_VIEWPORT,
+    STAGE_CULL,
+    STAGE_BIN,
+    STAGE_RASTER,
+    NUM_STAGES
+};
+
+/******************************************************
+ * Reasons the culling stage rejects a triangle.
+ *****************************************************/
+enum CULL_REASONS
+{
+    CULLED_DEGENERATE,
+    CULLED_BACKFACE,
+    CULLED_OUTSIDE,
+    CULLED_NO_SAMPLES,
+    NUM_CULL_REASONS
+};
+
+/******************************************************
+ * PIPELINE_STATS:
+ * Snapshot of the counters, modeled on GL pipeline 
+ * statistics queries. 'stageNs' is wall time spent in
+ * each stage; rasterization time in binned mode is the
+ * wall time of the parallel flush.
+ *****************************************************/
+struct PipelineStats
+{
+    uint64_t verticesShaded;
+    uint64_t primitivesSubmitted;
+    uint64_t primitivesClipped;
+    uint64_t primitivesCulled;
+    uint64_t primitivesCulledBy[NUM_CULL_REASONS];
+    uint64_t primitivesRasterized;
+    uint64_t fragmentsGenerated;
+    uint64_t fragmentsDepthRejected;
+    uint64_t fragmentsShaded;
+    uint64_t stageNs[NUM_STAGES];
+};
+
+/******************************************************
+ * STATS_STATE:
+ * Live counters. Workers add to them with relaxed 
+ * atomics, at most once per triangle per tile. When 
+ * disabled every hook is a single branch on 'enabled'.
+ *****************************************************/
+struct StatsState
+{
+    bool enabled;
+    std::atomic<uint64_t> verticesShaded;
+    std::atomic<uint64_t> primitivesSubmitted;
+    std::atomic<uint64_t> primitivesClipped;
+    std::atomic<uint64_t> primitivesCulled;
+    std::atomic<uint64_t> primitivesCulledBy[NUM_CULL_REASONS];
+    std::atomic<uint64_t> primitivesRasterized;
+    std::atomic<uint64_t> fragmentsGenerated;
+    std::atomic<uint64_t> fragmentsDepthRejected;
+    std::atomic<uint64_t> fragmentsShaded;
+    std::atomic<uint64_t> stageNs[NUM_STAGES];
+
+    StatsState() : enabled(false)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        verticesShaded = 0;
+        primitivesSubmitted = 0;
+        primitivesClipped = 0;
+        primitivesCulled = 0;
+        for(int r = 0; r < NUM_CULL_REASONS; r++)
+        {
+            primitivesCulledBy[r] = 0;
+        }
+        primitivesRasterized = 0;
+        fragmentsGenerated = 0;
+        fragmentsDepthRejected = 0;
+        fragmentsShaded = 0;
+        for(int s = 0; s < NUM_STAGES; s++)
+        {
+            stageNs[s] = 0;
+        }
+    }
+
+    PipelineStats snapshot() const
+    {
+        PipelineStats out;
+        out.verticesShaded = verticesShaded;
+        out.primitivesSubmitted = primitivesSubmitted;
+        out.primitivesClipped = primitivesClipped;
+        out.primitivesCulled = primitivesCulled;
+        for(int r = 0; r < NUM_CULL_REASONS; r++)
+        {
+            out.primitivesCulledBy[r] = primitivesCulledBy[r];
+        }
+        out.primitivesRasterized = primitivesRasterized;
+        out.fragmentsGenerated = fragmentsGenerated;
+        out.fragmentsDepthRejected = fragmentsDepthRejected;
+        out.fragmentsShaded = fragmentsShaded;
+        for(int s = 0; s < NUM_STAGES; s++)
+        {
+            out.stageNs[s] = stageNs[s];
+        }
+        return out;
+    }
+};
+
+inline StatsState & GetStatsState()
+{
+    static StatsState stats;
+    return stats;
+}
+
+// Adds 'n' to counter 'field' when statistics are enabled
+#define PIPELINE_STAT(field, n) do { if(GetStatsState().enabled) { GetStatsState().field.fetch_add((n), std::memory_order_relaxed); } } while(0)
+
+/******************************************************
+ * STAGE_TIMER:
+ * Adds the lifetime of the object to a stage's time, 
+ * when statistics are enabled.
+ *****************************************************/
+class StageTimer
+{
+    private:
+        PIPELINE_STAGES stage;
+        bool active;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        StageTimer(PIPELINE_STAGES s) : stage(s), active(GetStatsState().enabled)
+        {
+            if(active)
+            {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~StageTimer()
+        {
+            if(active)
+            {
+                std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+                GetStatsState().stageNs[stage].fetch_add((uint64_t)ns.count(), std::memory_order_relaxed);
+            }
+        }
+};
+
+/******************************************************
+ * Number of set bits in a coverage mask.
+ *****************************************************/
+inline int MaskBits(int mask)
+{
+    int bits = 0;
+    for(; mask != 0; mask &= mask - 1)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+#endif
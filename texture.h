@@ -0,0 +1,379 @@
+#include "definitions.h"
+
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+// Texels per side of a storage tile, 4x4 ARGB is one cache line
+#define TEXTURE_TILE_SHIFT 2
+#define TEXTURE_TILE (1 << TEXTURE_TILE_SHIFT)
+
+/******************************************************
+ * Texture addressing and filtering modes.
+ *****************************************************/
+enum TEXTURE_WRAP
+{
+    WRAP_REPEAT,
+    WRAP_CLAMP
+};
+
+enum TEXTURE_FILTER
+{
+    FILTER_NEAREST,
+    FILTER_BILINEAR
+};
+
+/******************************************************
+ * Position of (x, y) inside a 4x4 tile in Morton
+ * (Z) order, so 2x2 neighborhoods are adjacent. The x
+ * and y bits interleave without overlapping, so a 
+ * texel offset is a column part plus a row part.
+ *****************************************************/
+inline int MortonColumn(const int & x)
+{
+    return (x & 1) | ((x & 2) << 1);
+}
+
+inline int MortonRow(const int & y)
+{
+    return ((y & 1) << 1) | ((y & 2) << 2);
+}
+
+/******************************************************
+ * floorf without the library call, exact for the 
+ * coordinate range a texture can address.
+ *****************************************************/
+inline int FloorToInt(const float & f)
+{
+    int i = (int)f;
+    return i - (f < (float)i);
+}
+
+/******************************************************
+ * TEXTURE:
+ * Sampling-side copy of an image. Every level of the
+ * mip pyramid is stored in 4x4 tiles, each tile one
+ * aligned cache line with its texels in Morton order,
+ * so filter footprints touch one or two lines instead
+ * of one per row. Built once from a BufferImage (or any
+ * PIXEL buffer); (0, 0) is the bottom-left corner, as
+ * frames and images are stored bottom-up.
+ *****************************************************/
+class Texture
+{
+    private:
+        struct Level
+        {
+            int w;
+            int h;
+            int wMask;          // size - 1 for power of two sizes, else -1
+            int hMask;
+            int tilesX;
+            PIXEL* texels;
+        };
+
+        PIXEL* storage;
+        Level* mips;
+        int numLevels;
+        TEXTURE_WRAP wrapMode;
+        TEXTURE_FILTER filterMode;
+
+        void release()
+        {
+            alignedFree(storage);
+            delete [] mips;
+            storage = NULL;
+            mips = NULL;
+            numLevels = 0;
+        }
+
+        // Offsets of in-range column x and row y, texel (x, y) is at their sum
+        static int columnOffset(const int & x)
+        {
+            return ((x >> TEXTURE_TILE_SHIFT) << (2 * TEXTURE_TILE_SHIFT)) + MortonColumn(x);
+        }
+
+        static int rowOffset(const Level & level, const int & y)
+        {
+            return (((y >> TEXTURE_TILE_SHIFT) * level.tilesX) << (2 * TEXTURE_TILE_SHIFT)) + MortonRow(y);
+        }
+
+        static PIXEL & at(const Level & level, const int & x, const int & y)
+        {
+            return level.texels[rowOffset(level, y) + columnOffset(x)];
+        }
+
+        // Box filters 'src' into the next smaller level
+        static void downsample(const Level & src, const Level & dst)
+        {
+            for(int y = 0; y < dst.h; y++)
+            {
+                int y0 = 2 * y;
+                int y1 = 2 * y + 1 < src.h ? 2 * y + 1 : src.h - 1;
+                for(int x = 0; x < dst.w; x++)
+                {
+                    int x0 = 2 * x;
+                    int x1 = 2 * x + 1 < src.w ? 2 * x + 1 : src.w - 1;
+                    PIXEL quad[4] = { at(src, x0, y0), at(src, x1, y0), at(src, x0, y1), at(src, x1, y1) };
+                    PIXEL out = 0;
+                    for(int shift = 0; shift < 32; shift += 8)
+                    {
+                        unsigned int sum = 2;
+                        for(int i = 0; i < 4; i++)
+                        {
+                            sum += (quad[i] >> shift) & 0xff;
+                        }
+                        out |= (PIXEL)(sum >> 2) << shift;
+                    }
+                    at(dst, x, y) = out;
+                }
+            }
+        }
+
+        int wrap(const int & c, const int & size, const int & mask) const
+        {
+            if(wrapMode == WRAP_CLAMP)
+            {
+                return c < 0 ? 0 : (c >= size ? size - 1 : c);
+            }
+            if(mask >= 0)
+            {
+                return c & mask;
+            }
+            int m = c % size;
+            return m < 0 ? m + size : m;
+        }
+
+        // Filtered lookup in one level
+        PIXEL sampleLevel(const int & level, const float & u, const float & v) const
+        {
+            const Level & l = mips[level];
+            if(filterMode == FILTER_NEAREST)
+            {
+                return at(l, wrap(FloorToInt(u * l.w), l.w, l.wMask), wrap(FloorToInt(v * l.h), l.h, l.hMask));
+            }
+
+            // Bilinear: the four texel centers around (u, v)
+            float fx = u * l.w - 0.5f;
+            float fy = v * l.h - 0.5f;
+            int ix = FloorToInt(fx);
+            int iy = FloorToInt(fy);
+            float ax = fx - ix;
+            float ay = fy - iy;
+            int col0 = columnOffset(wrap(ix, l.w, l.wMask));
+            int col1 = columnOffset(wrap(ix + 1, l.w, l.wMask));
+            const PIXEL* row0 = l.texels + rowOffset(l, wrap(iy, l.h, l.hMask));
+            const PIXEL* row1 = l.texels + rowOffset(l, wrap(iy + 1, l.h, l.hMask));
+            PIXEL t00 = row0[col0];
+            PIXEL t10 = row0[col1];
+            PIXEL t01 = row1[col0];
+            PIXEL t11 = row1[col1];
+
+            // 8 bit fixed point weights, lerp along x then y
+            int wx = (int)(ax * 256);
+            int wy = (int)(ay * 256);
+#ifdef HAS_SSE2
+            // Channels widened to 16 bits, [t00 t10] and [t01 t11] per register
+            __m128i zero = _mm_setzero_si128();
+            __m128i texels = _mm_set_epi32((int)t11, (int)t01, (int)t10, (int)t00);
+            __m128i bottom = _mm_unpacklo_epi8(texels, zero);
+            __m128i top = _mm_unpackhi_epi8(texels, zero);
+            __m128i weightX = _mm_set_epi16(wx, wx, wx, wx, 256 - wx, 256 - wx, 256 - wx, 256 - wx);
+            __m128i weightY = _mm_set_epi16(wy, wy, wy, wy, 256 - wy, 256 - wy, 256 - wy, 256 - wy);
+            bottom = _mm_mullo_epi16(bottom, weightX);
+            top = _mm_mullo_epi16(top, weightX);
+            bottom = _mm_srli_epi16(_mm_add_epi16(bottom, _mm_srli_si128(bottom, 8)), 8);
+            top = _mm_srli_epi16(_mm_add_epi16(top, _mm_srli_si128(top, 8)), 8);
+            __m128i rows = _mm_mullo_epi16(_mm_unpacklo_epi64(bottom, top), weightY);
+            rows = _mm_srli_epi16(_mm_add_epi16(rows, _mm_srli_si128(rows, 8)), 8);
+            return (PIXEL)_mm_cvtsi128_si32(_mm_packus_epi16(rows, rows));
+#else
+            PIXEL out = 0;
+            for(int shift = 0; shift < 32; shift += 8)
+            {
+                unsigned int bottom = (((t00 >> shift) & 0xff) * (256 - wx) + ((t10 >> shift) & 0xff) * wx) >> 8;
+                unsigned int top = (((t01 >> shift) & 0xff) * (256 - wx) + ((t11 >> shift) & 0xff) * wx) >> 8;
+                out |= (PIXEL)((bottom * (256 - wy) + top * wy) >> 8) << shift;
+            }
+            return out;
+#endif
+        }
+
+        // Squared footprint length in level 0 texels
+        float footprint(const float & dudx, const float & dvdx, const float & dudy, const float & dvdy) const
+        {
+            float w = (float)mips[0].w;
+            float h = (float)mips[0].h;
+            float lenX = dudx * dudx * w * w + dvdx * dvdx * h * h;
+            float lenY = dudy * dudy * w * w + dvdy * dvdy * h * h;
+            return lenX > lenY ? lenX : lenY;
+        }
+
+    public:
+        Texture() : storage(NULL), mips(NULL), numLevels(0), wrapMode(WRAP_REPEAT), filterMode(FILTER_BILINEAR)
+        {
+        }
+
+        explicit Texture(const Buffer2D<PIXEL> & image) : storage(NULL), mips(NULL), numLevels(0),
+                                                         wrapMode(WRAP_REPEAT), filterMode(FILTER_BILINEAR)
+        {
+            build(image);
+        }
+
+        ~Texture()
+        {
+            release();
+        }
+
+        // Owns its pyramid, not copyable
+        Texture(const Texture &) = delete;
+        Texture & operator=(const Texture &) = delete;
+
+        // (Re)build the pyramid from 'image'
+        void build(const Buffer2D<PIXEL> & image)
+        {
+            release();
+            if(image.width() <= 0 || image.height() <= 0)
+            {
+                return;
+            }
+
+            // Level sizes and a single allocation, every level tile aligned
+            int w = image.width();
+            int h = image.height();
+            for(numLevels = 1; w > 1 || h > 1; numLevels++)
+            {
+                w = w > 1 ? w / 2 : 1;
+                h = h > 1 ? h / 2 : 1;
+            }
+            mips = new Level[numLevels];
+            size_t offsets[32];
+            size_t total = 0;
+            w = image.width();
+            h = image.height();
+            for(int l = 0; l < numLevels; l++)
+            {
+                mips[l].w = w;
+                mips[l].h = h;
+                mips[l].wMask = (w & (w - 1)) == 0 ? w - 1 : -1;
+                mips[l].hMask = (h & (h - 1)) == 0 ? h - 1 : -1;
+                mips[l].tilesX = (w + TEXTURE_TILE - 1) / TEXTURE_TILE;
+                int tilesY = (h + TEXTURE_TILE - 1) / TEXTURE_TILE;
+                offsets[l] = total;
+                total += (size_t)mips[l].tilesX * tilesY * TEXTURE_TILE * TEXTURE_TILE;
+                w = w > 1 ? w / 2 : 1;
+                h = h > 1 ? h / 2 : 1;
+            }
+            storage = (PIXEL*)alignedMalloc(total * sizeof(PIXEL));
+            memset(storage, 0, total * sizeof(PIXEL));
+            for(int l = 0; l < numLevels; l++)
+            {
+                mips[l].texels = storage + offsets[l];
+            }
+
+            for(int y = 0; y < mips[0].h; y++)
+            {
+                for(int x = 0; x < mips[0].w; x++)
+                {
+                    at(mips[0], x, y) = image[y][x];
+                }
+            }
+            for(int l = 1; l < numLevels; l++)
+            {
+                downsample(mips[l - 1], mips[l]);
+            }
+        }
+
+        int levels() const                        { return numLevels; }
+        int width(const int & level = 0) const    { return mips[level].w; }
+        int height(const int & level = 0) const   { return mips[level].h; }
+
+        void setWrap(TEXTURE_WRAP mode)           { wrapMode = mode; }
+        void setFilter(TEXTURE_FILTER mode)       { filterMode = mode; }
+
+        // Texel (x, y) of 'level', coordinates wrapped
+        PIXEL fetch(const int & level, const int & x, const int & y) const
+        {
+            const Level & l = mips[level];
+            return at(l, wrap(x, l.w, l.wMask), wrap(y, l.h, l.hMask));
+        }
+
+        /**************************************************
+         * Level of detail for a footprint given the
+         * screen-space derivatives of (u, v): log2 of the
+         * longer axis in level 0 texels.
+         *************************************************/
+        float lod(const float & dudx, const float & dvdx, const float & dudy, const float & dvdy) const
+        {
+            float rho2 = footprint(dudx, dvdx, dudy, dvdy);
+            return rho2 > 0 ? 0.5f * log2f(rho2) : 0.0f;
+        }
+
+        /**************************************************
+         * Samples at (u, v) in [0, 1] texture space from
+         * the level nearest to 'lod', with the current
+         * filter and wrap modes.
+         *************************************************/
+        PIXEL sample(const float & u, const float & v, const float & lod = 0) const
+        {
+            if(numLevels == 0)
+            {
+                return 0;
+            }
+            int level = (int)(lod + 0.5f);
+            level = level < 0 ? 0 : (level >= numLevels ? numLevels - 1 : level);
+            return sampleLevel(level, u, v);
+        }
+
+        /**************************************************
+         * Level for the derivatives of slots 'slot' and 
+         * 'slot' + 1, level 0 without derivatives.
+         *************************************************/
+        int levelOf(const AttributeGradients* grad, const int & slot) const
+        {
+            if(grad == NULL)
+            {
+                return 0;
+            }
+
+            // Nearest level is round(log2(rho2) / 2) = floor(log2(2 rho2)) / 2,
+            // and floor(log2) of a float is its exponent
+            float rho2 = 2 * footprint(grad->ddx[slot], grad->ddx[slot + 1], grad->ddy[slot], grad->ddy[slot + 1]);
+            uint32_t bits;
+            memcpy(&bits, &rho2, sizeof(bits));
+            int level = ((int)((bits >> 23) & 0xff) - 127) >> 1;
+            return level < 0 ? 0 : (level >= numLevels ? numLevels - 1 : level);
+        }
+
+        /**************************************************
+         * Samples using slots 'slot' and 'slot' + 1 of a
+         * fragment as (u, v), picking the level from the
+         * fragment's derivatives when it has them.
+         *************************************************/
+        PIXEL sample(const Attributes & frag, const int & slot) const
+        {
+            if(numLevels == 0)
+            {
+                return 0;
+            }
+            return sampleLevel(levelOf(frag.grad, slot), frag[slot], frag[slot + 1]);
+        }
+
+        /**************************************************
+         * Samples every covered lane of a quad into its
+         * color, with one level chosen for the quad.
+         *************************************************/
+        void sample(FragmentQuad & quad, const int & slot) const
+        {
+            int level = numLevels > 0 ? levelOf(&quad.grad, slot) : 0;
+            for(int lane = 0; lane < QUAD_LANES; lane++)
+            {
+                if((quad.mask >> lane) & 1)
+                {
+                    const Attributes & frag = quad.frag[lane];
+                    quad.color[lane] = numLevels > 0 ? sampleLevel(level, frag[slot], frag[slot + 1]) : 0;
+                }
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/******************************************************
+ * WORKER_POOL:
+ * A fixed set of threads that cooperatively run the
+ * iterations of a parallel loop. The calling thread 
+ * always takes part, so a pool of size 1 spawns no
+ * threads at all and runs everything in order.
+ *****************************************************/
+class WorkerPool
+{
+    private:
+        std::vector<std::thread> workers;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        std::function<void(int, int)> task;   // (item index, worker index)
+        int taskCount;
+        std::atomic<int> nextItem;
+        int generation;
+        int busy;
+        bool quit;
+
+        // Pull items until the loop is exhausted
+        void drain(const int & workerIdx)
+        {
+            int i;
+            while((i = nextItem.fetch_add(1)) < taskCount)
+            {
+                task(i, workerIdx);
+            }
+        }
+
+        // Worker thread body
+        void workerLoop(int workerIdx)
+        {
+            int seen = 0;
+            while(true)
+            {
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    wake.wait(guard, [&]{ return quit || generation != seen; });
+                    if(quit)
+                    {
+                        return;
+                    }
+                    seen = generation;
+                }
+
+                drain(workerIdx);
+
+                std::lock_guard<std::mutex> guard(lock);
+                if(--busy == 0)
+                {
+                    done.notify_one();
+                }
+            }
+        }
+
+        // Non-copyable
+        WorkerPool(const WorkerPool &);
+        WorkerPool& operator=(const WorkerPool &);
+
+    public:
+        // Spawn 'threads - 1' workers, the caller is the last one
+        WorkerPool(int threads) : taskCount(0), nextItem(0), generation(0), busy(0), quit(false)
+        {
+            for(int t = 1; t < threads; t++)
+            {
+                workers.push_back(std::thread(&WorkerPool::workerLoop, this, t));
+            }
+        }
+
+        // Join all workers
+        ~WorkerPool()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                quit = true;
+            }
+            wake.notify_all();
+            for(size_t t = 0; t < workers.size(); t++)
+            {
+                workers[t].join();
+            }
+        }
+
+        // Number of threads taking part in a loop, caller included
+        int size() const { return (int)workers.size() + 1; }
+
+        // Run fn(i, worker) for every i in [0, count), returns when all are done
+        void parallelFor(const int & count, const std::function<void(int, int)> & fn)
+        {
+            if(workers.empty() || count <= 1)
+            {
+                for(int i = 0; i < count; i++)
+                {
+                    fn(i, 0);
+                }
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                task = fn;
+                taskCount = count;
+                nextItem = 0;
+                busy = (int)workers.size();
+                generation++;
+            }
+            wake.notify_all();
+
+            drain(0);
+
+            std::unique_lock<std::mutex> guard(lock);
+            done.wait(guard, [&]{ return busy == 0; });
+            task = std::function<void(int, int)>();
+        }
+};
+
+#endif
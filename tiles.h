@@ -0,0 +1,376 @@
+#include "definitions.h"
+#include "threadpool.h"
+#include "stats.h"
+#include "halfspace.h"
+#include <algorithm>
+#include <type_traits>
+
+#ifndef TILES_H
+#define TILES_H
+
+// Upper bound on queued triangles before an automatic flush
+#define MAX_QUEUED_TRIANGLES 65536
+
+/******************************************************
+ * SCREEN_RECT:
+ * Half-open pixel rectangle [x0, x1) x [y0, y1).
+ *****************************************************/
+struct ScreenRect
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+// Overlap of two rectangles, empty (x0 >= x1 or y0 >= y1) if none
+inline ScreenRect IntersectRects(const ScreenRect & a, const ScreenRect & b)
+{
+    ScreenRect out;
+    out.x0 = a.x0 > b.x0 ? a.x0 : b.x0;
+    out.y0 = a.y0 > b.y0 ? a.y0 : b.y0;
+    out.x1 = a.x1 < b.x1 ? a.x1 : b.x1;
+    out.y1 = a.y1 < b.y1 ? a.y1 : b.y1;
+    return out;
+}
+
+struct TriangleJob;
+
+// Raster loop instantiated for the job's fragment shader type
+typedef void (*RasterFunc)(const TriangleJob & job, const ScreenRect & clip);
+
+/******************************************************
+ * TRIANGLE_JOB:
+ * Everything the rasterizer needs for one triangle 
+ * after the viewport transform. Uniforms and a copy of
+ * the fragment shader object are held by value so the 
+ * job can outlive the draw call that produced it.
+ *****************************************************/
+struct TriangleJob
+{
+    RasterVertex verts[3];
+    Attributes attrs[3];
+    Attributes uniforms;
+    RasterFunc raster;
+    alignas(16) unsigned char shader[MAX_SHADER_STATE];
+    Buffer2D<PIXEL>* target;
+    DepthBuffer* zBuf;
+    ScreenRect bounds;      // Pixels it may write (viewport, scissor)
+};
+
+/******************************************************
+ * TILE_RENDERER:
+ * Bins triangles into square screen tiles and later 
+ * rasterizes the tiles in parallel. Every tile replays
+ * its triangles in submission order and tiles never 
+ * share pixels, so the result matches serial drawing.
+ *****************************************************/
+class TileRenderer
+{
+    private:
+        std::vector<TriangleJob> jobs;
+        std::vector< std::vector<int> > bins;
+        std::vector<int> activeBins;
+        WorkerPool* pool;
+        Buffer2D<PIXEL>* binnedTarget;
+        int gridW;              // Size of 'binnedTarget' when binned
+        int gridH;
+        int tileSize;
+        int tilesX;
+        int tilesY;
+
+        // Lazy clears: color tiles flagged here are filled on first touch,
+        // depth buffers carry their own flags (DepthBuffer::deferClear)
+        bool lazyClear;
+        std::vector<unsigned char> colorPending;
+        PIXEL clearColor;
+
+        // Size the bin grid for a new render target. Color tiles still
+        // pending belong to a frame left unfinished mid-draw, they are 
+        // filled like the triangles flushed for it; nothing else is 
+        // written through the old target.
+        void resizeBins(Buffer2D<PIXEL>* target)
+        {
+            resolveClears();
+            binnedTarget = target;
+            gridW = target->width();
+            gridH = target->height();
+            tilesX = (target->width()  + tileSize - 1) / tileSize;
+            tilesY = (target->height() + tileSize - 1) / tileSize;
+            bins.resize(tilesX * tilesY);
+            colorPending.assign(tilesX * tilesY, 0);
+        }
+
+        // Settle a depth buffer's deferred clear now when its tiles are
+        // not those of the current grid
+        void matchDepth(DepthBuffer* depth)
+        {
+            if(depth != NULL && depth->deferredTile() != 0 &&
+               (depth->deferredTile() != tileSize || binnedTarget == NULL ||
+                depth->width() != gridW || depth->height() != gridH))
+            {
+                depth->resolveClears();
+            }
+        }
+
+        // True if the grid is binned over 'target' at its current size. A
+        // new buffer may reuse a freed one's address, so both are compared.
+        bool binnedTo(const Buffer2D<PIXEL>* target) const
+        {
+            return binnedTarget == target && gridW == target->width() && gridH == target->height();
+        }
+
+        // Pixel rectangle of bin 'b'
+        ScreenRect tileRect(const int & b) const
+        {
+            int w = gridW;
+            int h = gridH;
+            ScreenRect rect;
+            rect.x0 = (b % tilesX) * tileSize;
+            rect.y0 = (b / tilesX) * tileSize;
+            rect.x1 = rect.x0 + tileSize < w ? rect.x0 + tileSize : w;
+            rect.y1 = rect.y0 + tileSize < h ? rect.y0 + tileSize : h;
+            return rect;
+        }
+
+        // Perform the deferred color clear of bin 'b', if any
+        void touchTile(const int & b, const ScreenRect & rect)
+        {
+            if(colorPending[b])
+            {
+                binnedTarget->fillRect(rect.x0, rect.y0, rect.x1, rect.y1, clearColor);
+                colorPending[b] = 0;
+            }
+        }
+
+        // Carry out every deferred color clear of the current grid
+        void resolveClears()
+        {
+            if(binnedTarget == NULL || std::find(colorPending.begin(), colorPending.end(), 1) == colorPending.end())
+            {
+                return;
+            }
+            pool->parallelFor(tilesX * tilesY, [&](int b, int)
+            {
+                touchTile(b, tileRect(b));
+            });
+        }
+
+        // True if deferred clears apply to 'target'
+        bool deferring(Buffer2D<PIXEL> & target)
+        {
+            return lazyClear && threads() > 1 && binnedTo(&target);
+        }
+
+        // Non-copyable
+        TileRenderer(const TileRenderer &);
+        TileRenderer& operator=(const TileRenderer &);
+
+    public:
+        TileRenderer() : pool(new WorkerPool(1)), binnedTarget(NULL), gridW(0), gridH(0), tileSize(64), tilesX(0), tilesY(0),
+                         lazyClear(false), clearColor(0)
+        {}
+
+        ~TileRenderer()
+        {
+            delete pool;
+        }
+
+        // Thread count, caller included; 1 means draw immediately
+        int threads() const { return pool->size(); }
+
+        // Pool shared with other parallel stages, idle between flushes
+        WorkerPool & workers() { return *pool; }
+
+        void setThreads(int count)
+        {
+            flush();
+            resolveClears();
+            delete pool;
+            pool = new WorkerPool(count < 1 ? 1 : count);
+        }
+
+        // Tile edge length in pixels
+        int tile() const { return tileSize; }
+
+        void setTileSize(int size)
+        {
+            flush();
+            resolveClears();
+            // Keep tiles whole multiples of the 4x4 raster block
+            tileSize = size < 8 ? 8 : (size + 3) & ~3;
+            binnedTarget = NULL;
+        }
+
+        // Defer clears to a tile's first touch (binned mode only)
+        void setLazyClear(bool lazy)
+        {
+            flush();
+            resolveClears();
+            lazyClear = lazy;
+        }
+
+        // Clear 'target' to 'color', now or lazily per tile
+        void clearTarget(Buffer2D<PIXEL> & target, const PIXEL & color)
+        {
+            flush();
+            if(!lazyClear || threads() == 1)
+            {
+                target.fill(color);
+                return;
+            }
+            if(!binnedTo(&target))
+            {
+                resizeBins(&target);
+            }
+            clearColor = color;
+            colorPending.assign(tilesX * tilesY, 1);
+        }
+
+        // Clear 'depth', lazily per tile when it matches the binned target.
+        // The flags live in the buffer, so any number of depth buffers can
+        // be pending at once and switching targets never touches them.
+        void clearDepth(DepthBuffer & depth)
+        {
+            flush();
+            bool matches = binnedTarget != NULL && depth.width() == gridW && depth.height() == gridH;
+            if(!lazyClear || threads() == 1 || !matches)
+            {
+                depth.clear();
+                return;
+            }
+            depth.deferClear(tileSize);
+        }
+
+        // Flush, then fill color tiles nothing was drawn to. Depth 
+        // tiles stay pending in their buffers; they are only needed 
+        // once drawn to.
+        void finishFrame()
+        {
+            flush();
+            resolveClears();
+        }
+
+        // Queue a triangle, binning it into every tile its bounds touch
+        void submit(const TriangleJob & job)
+        {
+            if(!binnedTo(job.target))
+            {
+                flush();
+                resizeBins(job.target);
+            }
+            else if(jobs.size() >= MAX_QUEUED_TRIANGLES)
+            {
+                flush();
+            }
+            matchDepth(job.zBuf);
+
+            // Pixel bounds of the snapped vertices
+            const RasterVertex* v = job.verts;
+            int minX = std::min(v[0].x, std::min(v[1].x, v[2].x)) >> SUBPIXEL_BITS;
+            int maxX = std::max(v[0].x, std::max(v[1].x, v[2].x)) >> SUBPIXEL_BITS;
+            int minY = std::min(v[0].y, std::min(v[1].y, v[2].y)) >> SUBPIXEL_BITS;
+            int maxY = std::max(v[0].y, std::max(v[1].y, v[2].y)) >> SUBPIXEL_BITS;
+            const ScreenRect & bounds = job.bounds;
+            if(maxX < bounds.x0 || maxY < bounds.y0 || minX >= bounds.x1 || minY >= bounds.y1)
+            {
+                return;
+            }
+
+            int tx0 = std::max(minX, bounds.x0) / tileSize;
+            int ty0 = std::max(minY, bounds.y0) / tileSize;
+            int tx1 = std::min(maxX, bounds.x1 - 1) / tileSize;
+            int ty1 = std::min(maxY, bounds.y1 - 1) / tileSize;
+
+            int idx = (int)jobs.size();
+            jobs.push_back(job);
+            for(int ty = ty0; ty <= ty1; ty++)
+            {
+                for(int tx = tx0; tx <= tx1; tx++)
+                {
+                    std::vector<int> & bin = bins[ty * tilesX + tx];
+                    if(bin.empty())
+                    {
+                        activeBins.push_back(ty * tilesX + tx);
+                    }
+                    bin.push_back(idx);
+                }
+            }
+        }
+
+        // Tile grid over 'target', flushing work queued for another target
+        void tileGrid(Buffer2D<PIXEL> & target, int & across, int & down)
+        {
+            if(!binnedTo(&target))
+            {
+                flush();
+                resizeBins(&target);
+            }
+            across = tilesX;
+            down = tilesY;
+        }
+
+        // Flush, then run fn(b, rect) for every bin in 'list' of the current
+        // grid in parallel, each after its deferred clears of the target and
+        // 'depth'. Stages drawing outside the triangle queue stay ordered 
+        // with it this way.
+        void runTiles(const std::vector<int> & list, DepthBuffer* depth, const std::function<void(int, const ScreenRect &)> & fn)
+        {
+            flush();
+            matchDepth(depth);
+            pool->parallelFor((int)list.size(), [&](int i, int)
+            {
+                ScreenRect rect = tileRect(list[i]);
+                touchTile(list[i], rect);
+                if(depth != NULL)
+                {
+                    depth->touchTile(list[i]);
+                }
+                fn(list[i], rect);
+            });
+        }
+
+        // Rasterize everything queued so far
+        void flush()
+        {
+            if(jobs.empty())
+            {
+                return;
+            }
+            StageTimer timer(STAGE_RASTER);
+
+            pool->parallelFor((int)activeBins.size(), [&](int i, int)
+            {
+                int b = activeBins[i];
+                ScreenRect tile = tileRect(b);
+                touchTile(b, tile);
+
+                std::vector<int> & bin = bins[b];
+                for(size_t t = 0; t < bin.size(); t++)
+                {
+                    const TriangleJob & job = jobs[bin[t]];
+                    if(job.zBuf != NULL)
+                    {
+                        job.zBuf->touchTile(b);
+                    }
+                    job.raster(job, IntersectRects(tile, job.bounds));
+                }
+                bin.clear();
+            });
+
+            activeBins.clear();
+            jobs.clear();
+        }
+};
+
+/******************************************************
+ * GET_TILE_RENDERER:
+ * The binning back end shared by all draw calls.
+ *****************************************************/
+inline TileRenderer & GetTileRenderer()
+{
+    static TileRenderer tiles;
+    return tiles;
+}
+
+#endif
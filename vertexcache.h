@@ -0,0 +1,251 @@
+#include "definitions.h"
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#ifndef VERTEX_CACHE_H
+#define VERTEX_CACHE_H
+
+/******************************************************
+ * POST_TRANSFORM_CACHE:
+ * Remembers vertex shader outputs by vertex index for 
+ * the duration of one indexed draw, so each unique 
+ * vertex is shaded exactly once no matter how many 
+ * primitives share it. Entries are invalidated by 
+ * bumping a generation stamp rather than clearing.
+ *****************************************************/
+class PostTransformCache
+{
+    private:
+        std::vector<Vertex> verts;
+        std::vector<Attributes> attrs;
+        std::vector<unsigned int> stamps;
+        unsigned int generation;
+        unsigned int base;
+
+    public:
+        PostTransformCache() : generation(0), base(0)
+        {}
+
+        // Start a new draw covering indices [lo, hi]
+        void begin(const unsigned int & lo, const unsigned int & hi)
+        {
+            size_t span = (size_t)(hi - lo) + 1;
+            if(span > stamps.size())
+            {
+                verts.resize(span);
+                attrs.resize(span);
+                stamps.resize(span, 0);
+            }
+            base = lo;
+            if(++generation == 0)
+            {
+                // Stamp wrapped around, start from a clean slate
+                std::fill(stamps.begin(), stamps.end(), 0);
+                generation = 1;
+            }
+        }
+
+        // True if 'index' was shaded during this draw
+        bool contains(const unsigned int & index) const
+        {
+            return stamps[index - base] == generation;
+        }
+
+        // Slot for 'index', marking it valid for this draw
+        void store(const unsigned int & index, Vertex* & v, Attributes* & a)
+        {
+            stamps[index - base] = generation;
+            v = &verts[index - base];
+            a = &attrs[index - base];
+        }
+
+        // Contiguous slots for 'count' indices from 'first', marking them valid
+        void storeRange(const unsigned int & first, const unsigned int & count, Vertex* & v, Attributes* & a)
+        {
+            std::fill(stamps.begin() + (first - base), stamps.begin() + (first - base + count), generation);
+            v = &verts[first - base];
+            a = &attrs[first - base];
+        }
+
+        const Vertex & vertex(const unsigned int & index) const          { return verts[index - base]; }
+        const Attributes & attributes(const unsigned int & index) const  { return attrs[index - base]; }
+};
+
+/******************************************************
+ * OPTIMIZE_VERTEX_CACHE:
+ * Reorders the triangles of an indexed triangle list
+ * (Forsyth's linear-speed algorithm) so vertices are
+ * reused while still recently seen. A simulated LRU
+ * cache of VERTEX_CACHE_SIZE entries scores vertices
+ * by cache position and by how many triangles still
+ * use them; the best-scoring triangle touching the
+ * cache goes next, or the next unused one in input
+ * order when none does. Consecutive triangles then 
+ * share vertices and stay close on screen, which keeps
+ * vertex fetch, the post-transform cache range and 
+ * tile binning local. Indices must all be below
+ * 'numVerts'; the output is deterministic.
+ *****************************************************/
+#define VERTEX_CACHE_SIZE 16
+#define VERTEX_VALENCE_TABLE 64
+
+inline void OptimizeVertexCache(unsigned int indices[], const int & count, const int & numVerts)
+{
+    int numTris = count / 3;
+    if(numTris <= 1 || numVerts <= 0)
+    {
+        return;
+    }
+
+    // Score tables, by cache position and by remaining triangle count
+    float positionScore[VERTEX_CACHE_SIZE];
+    float valenceScore[VERTEX_VALENCE_TABLE];
+    for(int i = 0; i < VERTEX_CACHE_SIZE; i++)
+    {
+        positionScore[i] = i < 3 ? 0.75f : powf(1.0f - (i - 3) * (1.0f / (VERTEX_CACHE_SIZE - 3)), 1.5f);
+    }
+    for(int i = 1; i < VERTEX_VALENCE_TABLE; i++)
+    {
+        valenceScore[i] = 2.0f / sqrtf((float)i);
+    }
+    auto vertexScore = [&](const int & cachePos, const int & remaining) -> float
+    {
+        if(remaining == 0)
+        {
+            return -1.0f;
+        }
+        float score = cachePos >= 0 ? positionScore[cachePos] : 0.0f;
+        return score + (remaining < VERTEX_VALENCE_TABLE ? valenceScore[remaining] : 2.0f / sqrtf((float)remaining));
+    };
+
+    // Triangles using each vertex, the still-unused ones first
+    std::vector<int> offsets(numVerts + 1, 0);
+    for(int i = 0; i < numTris * 3; i++)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    for(int v = 0; v < numVerts; v++)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<int> remaining(numVerts, 0);
+    std::vector<int> triLists(numTris * 3);
+    for(int i = 0; i < numTris * 3; i++)
+    {
+        unsigned int v = indices[i];
+        triLists[offsets[v] + remaining[v]++] = i / 3;
+    }
+
+    std::vector<float> vertScores(numVerts);
+    for(int v = 0; v < numVerts; v++)
+    {
+        vertScores[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<char> emitted(numTris, 0);
+    std::vector<unsigned int> order(numTris * 3);
+
+    int cache[VERTEX_CACHE_SIZE + 3];
+    int cacheSize = 0;
+    int best = -1;
+    int cursor = 0;
+    for(int n = 0; n < numTris; n++)
+    {
+        if(best < 0)
+        {
+            while(emitted[cursor])
+            {
+                cursor++;
+            }
+            best = cursor;
+        }
+        emitted[best] = 1;
+
+        // Emit, and move the triangle's vertices to the front of the cache
+        int next[VERTEX_CACHE_SIZE + 3];
+        int nextSize = 0;
+        for(int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[best * 3 + k];
+            order[n * 3 + k] = v;
+            next[nextSize++] = (int)v;
+
+            int* list = &triLists[offsets[v]];
+            for(int j = 0; j < remaining[v]; j++)
+            {
+                if(list[j] == best)
+                {
+                    list[j] = list[--remaining[v]];
+                    break;
+                }
+            }
+        }
+        for(int i = 0; i < cacheSize; i++)
+        {
+            if(cache[i] != next[0] && cache[i] != next[1] && cache[i] != next[2])
+            {
+                next[nextSize++] = cache[i];
+            }
+        }
+
+        // Vertices pushed past the end leave the cache
+        for(int i = VERTEX_CACHE_SIZE; i < nextSize; i++)
+        {
+            vertScores[next[i]] = vertexScore(-1, remaining[next[i]]);
+        }
+        cacheSize = nextSize < VERTEX_CACHE_SIZE ? nextSize : VERTEX_CACHE_SIZE;
+        for(int i = 0; i < cacheSize; i++)
+        {
+            cache[i] = next[i];
+            vertScores[next[i]] = vertexScore(i, remaining[next[i]]);
+        }
+
+        // Best remaining triangle that touches the cache
+        best = -1;
+        float bestScore = -1.0f;
+        for(int i = 0; i < cacheSize; i++)
+        {
+            const int* list = &triLists[offsets[cache[i]]];
+            for(int j = 0; j < remaining[cache[i]]; j++)
+            {
+                const unsigned int* tri = &indices[list[j] * 3];
+                float score = vertScores[tri[0]] + vertScores[tri[1]] + vertScores[tri[2]];
+                if(score > bestScore)
+                {
+                    best = list[j];
+                    bestScore = score;
+                }
+            }
+        }
+    }
+    std::copy(order.begin(), order.end(), indices);
+}
+
+/******************************************************
+ * CACHE_MISS_RATIO:
+ * Average vertices transformed per triangle through a
+ * FIFO cache of 'cacheSize' entries (ACMR), the usual 
+ * measure of index order quality: 3 for no reuse, 
+ * approaching 0.5 for a well-ordered regular mesh.
+ *****************************************************/
+inline double CacheMissRatio(const unsigned int indices[], const int & count, const int & numVerts, const int & cacheSize = VERTEX_CACHE_SIZE)
+{
+    int numTris = count / 3;
+    if(numTris <= 0)
+    {
+        return 0;
+    }
+    std::vector<int> insertedAt(numVerts, -cacheSize - 1);
+    int misses = 0;
+    for(int i = 0; i < numTris * 3; i++)
+    {
+        // Vertex still cached if fewer than 'cacheSize' misses happened since
+        if(misses - insertedAt[indices[i]] > cacheSize)
+        {
+            insertedAt[indices[i]] = misses++;
+        }
+    }
+    return (double)misses / numTris;
+}
+
+#endif
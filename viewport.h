@@ -0,0 +1,62 @@
+#include "definitions.h"
+#include "tiles.h"
+
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+/******************************************************
+ * VIEWPORT_STATE:
+ * Pipeline state placing draws inside a render target.
+ * The viewport maps NDC onto its rectangle and also
+ * bounds every pixel a draw may write, so views
+ * sharing a target never bleed into each other (guard
+ * band geometry included). The scissor, when enabled,
+ * narrows that further. A zero-sized viewport means
+ * the whole target. Rectangles are in target pixels,
+ * origin bottom-left like the frames.
+ *
+ * Triangles carry the resulting bounds into the tile
+ * queue, so draws to different views of one target
+ * are binned together and rasterize concurrently on
+ * the next flush.
+ *****************************************************/
+struct ViewportState
+{
+    ScreenRect viewport;
+    ScreenRect scissor;
+    bool scissorTest;
+
+    ViewportState() : scissorTest(false)
+    {
+        ScreenRect none = {0, 0, 0, 0};
+        viewport = none;
+        scissor = none;
+    }
+};
+
+inline ViewportState & GetViewportState()
+{
+    static ViewportState state;
+    return state;
+}
+
+// Viewport rectangle in 'target'
+inline ScreenRect ViewportRect(const ViewportState & state, const Buffer2D<PIXEL> & target)
+{
+    if(state.viewport.x1 <= state.viewport.x0 || state.viewport.y1 <= state.viewport.y0)
+    {
+        ScreenRect whole = {0, 0, target.width(), target.height()};
+        return whole;
+    }
+    return state.viewport;
+}
+
+// Pixels of 'target' a draw may write: target, viewport and scissor
+inline ScreenRect DrawBounds(const ViewportState & state, const Buffer2D<PIXEL> & target)
+{
+    ScreenRect whole = {0, 0, target.width(), target.height()};
+    ScreenRect bounds = IntersectRects(whole, ViewportRect(state, target));
+    return state.scissorTest ? IntersectRects(bounds, state.scissor) : bounds;
+}
+
+#endif